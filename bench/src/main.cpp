@@ -0,0 +1,733 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/aruco.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "aruco_markers/detection.hpp"
+#include "aruco_markers/detector_tuner.hpp"
+#include "aruco_markers/identification.hpp"
+#include "aruco_markers/overlay.hpp"
+#include "aruco_markers/pose.hpp"
+#include "aruco_markers/threshold.hpp"
+
+
+namespace {
+const char* about =
+        "Benchmark marker detection and pose estimation on synthetic frames\n"
+        "  Markers are rendered into frames at known poses. For every\n"
+        "  combination of the listed resolutions, dictionaries, marker\n"
+        "  counts, blur and noise levels the latency of each stage, the\n"
+        "  throughput and the pose error are reported as JSON. The adaptive\n"
+        "  threshold sweep of the detector is timed separately, once with\n"
+        "  cv::adaptiveThreshold per window and once from a shared integral\n"
+        "  image. Identification of candidate bit patterns is timed with\n"
+        "  cv::aruco::Dictionary::identify and with packed codewords. The\n"
+        "  pose overlay is timed drawn marker by marker and batched.\n";
+const char* keys  =
+        "{res      |640x480,1920x1080 | Comma separated frame resolutions }"
+        "{d        |0,16  | Comma separated dictionary ids, see detect_markers }"
+        "{n        |1,16  | Comma separated numbers of markers per frame }"
+        "{blur     |0,1.5 | Comma separated Gaussian blur sigmas in pixels }"
+        "{noise    |0,8   | Comma separated noise standard deviations }"
+        "{frames   |30    | Frames per configuration }"
+        "{l        |0.05  | Marker side length in meter }"
+        "{dec      |1     | Detection decimation factor }"
+        "{tiles    |1     | Detection tiles per side }"
+        "{overlap  |128   | Tile overlap in pixels }"
+        "{dp       |<none>| File of marker detector parameters }"
+        "{seed     |42    | Random seed for the generated scenes }"
+        "{o        |<none>| Output file, otherwise stdout }"
+        "{h        |false | Print help }"
+        ;
+
+struct Scene
+{
+    cv::Mat image;
+    std::vector<int> ids;
+    std::vector<cv::Vec3d> rvecs, tvecs;
+};
+
+struct Config
+{
+    cv::Size size;
+    int dictionary;
+    int markers;
+    double blur;
+    double noise;
+};
+
+struct Summary
+{
+    double mean, p50, p90, p99, max;
+};
+
+std::vector<std::string> split(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+bool parseSizes(const std::string& list, std::vector<cv::Size>& sizes)
+{
+    std::vector<std::string> items = split(list);
+    for (size_t i = 0; i < items.size(); i++) {
+        int width, height;
+        if (std::sscanf(items[i].c_str(), "%dx%d", &width, &height) != 2 ||
+            width <= 0 || height <= 0)
+            return false;
+        sizes.push_back(cv::Size(width, height));
+    }
+    return !sizes.empty();
+}
+
+template <typename T>
+bool parseList(const std::string& list, std::vector<T>& values)
+{
+    std::vector<std::string> items = split(list);
+    for (size_t i = 0; i < items.size(); i++) {
+        std::istringstream stream(items[i]);
+        T value;
+        if (!(stream >> value))
+            return false;
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+Summary summarize(std::vector<double> values)
+{
+    Summary s = { 0, 0, 0, 0, 0 };
+    if (values.empty())
+        return s;
+    std::sort(values.begin(), values.end());
+    for (size_t i = 0; i < values.size(); i++)
+        s.mean += values[i];
+    s.mean /= values.size();
+    s.p50 = values[static_cast<size_t>(0.50 * (values.size() - 1) + 0.5)];
+    s.p90 = values[static_cast<size_t>(0.90 * (values.size() - 1) + 0.5)];
+    s.p99 = values[static_cast<size_t>(0.99 * (values.size() - 1) + 0.5)];
+    s.max = values.back();
+    return s;
+}
+
+std::string toJson(const Summary& s)
+{
+    return cv::format("{\"mean\":%.4f,\"p50\":%.4f,\"p90\":%.4f,"
+                      "\"p99\":%.4f,\"max\":%.4f}",
+                      s.mean, s.p50, s.p90, s.p99, s.max);
+}
+
+double elapsedMs(int64_t start)
+{
+    return (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+}
+
+cv::Mat syntheticCameraMatrix(cv::Size size)
+{
+    double f = 0.9 * size.width;
+    return (cv::Mat_<double>(3, 3) << f, 0, 0.5 * (size.width - 1),
+                                      0, f, 0.5 * (size.height - 1),
+                                      0, 0, 1);
+}
+
+/**
+ * Renders markers at random poses into a frame. Markers are spread over a
+ * grid so they do not overlap, tilted by up to 40 degrees and sized to
+ * fill about half of their grid cell.
+ */
+Scene renderScene(const Config& config,
+                  const cv::Ptr<cv::aruco::Dictionary>& dictionary,
+                  const cv::Mat& camera_matrix, float marker_length,
+                  cv::RNG& rng)
+{
+    Scene scene;
+    scene.image.create(config.size, CV_8UC1);
+    scene.image.setTo(cv::Scalar(128));
+
+    int grid = static_cast<int>(std::ceil(std::sqrt(
+        static_cast<double>(config.markers))));
+    double cell_w = static_cast<double>(config.size.width) / grid;
+    double cell_h = static_cast<double>(config.size.height) / grid;
+    double f = camera_matrix.at<double>(0, 0);
+    double depth = f * marker_length / (0.5 * std::min(cell_w, cell_h));
+
+    // marker image with a one-bit white quiet zone around it
+    const int marker_px = 120;
+    int quiet_px = marker_px / (dictionary->markerSize + 2);
+    int source_px = marker_px + 2 * quiet_px;
+    double half = 0.5 * marker_length * source_px / marker_px;
+    std::vector<cv::Point3f> object_corners;
+    object_corners.push_back(cv::Point3f(-half, half, 0));
+    object_corners.push_back(cv::Point3f(half, half, 0));
+    object_corners.push_back(cv::Point3f(half, -half, 0));
+    object_corners.push_back(cv::Point3f(-half, -half, 0));
+    std::vector<cv::Point2f> source_corners;
+    source_corners.push_back(cv::Point2f(0, 0));
+    source_corners.push_back(cv::Point2f(source_px, 0));
+    source_corners.push_back(cv::Point2f(source_px, source_px));
+    source_corners.push_back(cv::Point2f(0, source_px));
+
+    // facing the camera: marker y up and z towards the camera
+    cv::Matx33d facing(1, 0, 0, 0, -1, 0, 0, 0, -1);
+    cv::Matx33d camera_inv = cv::Matx33d(camera_matrix).inv();
+
+    cv::Mat marker, source(source_px, source_px, CV_8UC1);
+    for (int i = 0; i < config.markers; i++) {
+        int id = i % dictionary->bytesList.rows;
+        cv::aruco::drawMarker(dictionary, id, marker_px, marker, 1);
+        source.setTo(cv::Scalar(255));
+        marker.copyTo(source(cv::Rect(quiet_px, quiet_px, marker_px,
+                                      marker_px)));
+
+        cv::Vec3d tilt(rng.uniform(-0.7, 0.7), rng.uniform(-0.7, 0.7),
+                       rng.uniform(-CV_PI, CV_PI));
+        cv::Matx33d tilt_rotation;
+        cv::Rodrigues(tilt, tilt_rotation);
+        cv::Vec3d rvec;
+        cv::Rodrigues(cv::Matx33d(tilt_rotation * facing), rvec);
+
+        cv::Vec3d pixel((i % grid + 0.5) * cell_w, (i / grid + 0.5) * cell_h,
+                        1.0);
+        cv::Vec3d tvec = camera_inv * pixel * depth;
+
+        std::vector<cv::Point2f> image_corners;
+        cv::projectPoints(object_corners, rvec, tvec, camera_matrix,
+                          cv::noArray(), image_corners);
+        cv::Mat homography = cv::getPerspectiveTransform(source_corners,
+                                                         image_corners);
+        cv::warpPerspective(source, scene.image, homography, config.size,
+                            cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
+
+        scene.ids.push_back(id);
+        scene.rvecs.push_back(rvec);
+        scene.tvecs.push_back(tvec);
+    }
+
+    if (config.blur > 0)
+        cv::GaussianBlur(scene.image, scene.image, cv::Size(0, 0),
+                         config.blur);
+    if (config.noise > 0) {
+        cv::Mat noise(config.size, CV_16SC1);
+        rng.fill(noise, cv::RNG::NORMAL, 0, config.noise);
+        cv::Mat image;
+        scene.image.convertTo(image, CV_16SC1);
+        image += noise;
+        image.convertTo(scene.image, CV_8UC1);
+    }
+    cv::cvtColor(scene.image, scene.image, cv::COLOR_GRAY2BGR);
+    return scene;
+}
+
+/**
+ * Bit patterns as read from marker candidates: dictionary markers in any
+ * rotation with up to the correctable number of flipped bits, and one in
+ * four random patterns standing in for clutter.
+ */
+std::vector<cv::Mat> candidateBits(
+    const cv::Ptr<cv::aruco::Dictionary>& dictionary, int count, cv::RNG& rng)
+{
+    int n = dictionary->markerSize;
+    std::vector<cv::Mat> candidates;
+    for (int i = 0; i < count; i++) {
+        cv::Mat bits(n, n, CV_8UC1);
+        if (i % 4 == 3) {
+            cv::randu(bits, 0, 2);
+        } else {
+            int id = rng.uniform(0, dictionary->bytesList.rows);
+            bits = cv::aruco::Dictionary::getBitsFromByteList(
+                dictionary->bytesList.rowRange(id, id + 1), n);
+            for (int r = rng.uniform(0, 4); r > 0; r--)
+                cv::rotate(bits, bits, cv::ROTATE_90_CLOCKWISE);
+            for (int e = rng.uniform(0, dictionary->maxCorrectionBits + 1);
+                 e > 0; e--) {
+                uchar& bit = bits.at<uchar>(rng.uniform(0, n),
+                                            rng.uniform(0, n));
+                bit = bit ? 0 : 1;
+            }
+        }
+        candidates.push_back(bits);
+    }
+    return candidates;
+}
+
+double rotationErrorDeg(const cv::Vec3d& expected, const cv::Vec3d& actual)
+{
+    cv::Matx33d r_expected, r_actual;
+    cv::Rodrigues(expected, r_expected);
+    cv::Rodrigues(actual, r_actual);
+    cv::Matx33d difference = r_expected.t() * r_actual;
+    double c = 0.5 * (difference(0, 0) + difference(1, 1) +
+                      difference(2, 2) - 1.0);
+    return std::acos(std::max(-1.0, std::min(1.0, c))) * 180.0 / CV_PI;
+}
+
+/**
+ * The overlay as pose_estimation drew it before PoseOverlay: one
+ * projection and one set of lines per marker, the text formatted anew
+ * for every marker.
+ */
+void drawOverlayPerMarker(cv::Mat& image, const cv::Mat& camera_matrix,
+                          const aruco_markers::MarkerCorners& corners,
+                          const std::vector<int>& ids,
+                          const std::vector<cv::Vec3d>& rvecs,
+                          const std::vector<cv::Vec3d>& tvecs)
+{
+    cv::aruco::drawDetectedMarkers(image, corners, ids);
+    std::ostringstream text;
+    for (size_t i = 0; i < ids.size(); i++) {
+        cv::aruco::drawAxis(image, camera_matrix, cv::noArray(), rvecs[i],
+                            tvecs[i], 0.1f);
+        for (int axis = 0; axis < 3; axis++) {
+            text.str(std::string());
+            text << std::setprecision(4) << "xyz"[axis] << ": "
+                 << std::setw(8) << tvecs[0](axis);
+            cv::putText(image, text.str(), cv::Point(10, 30 + 20 * axis),
+                        cv::FONT_HERSHEY_SIMPLEX, 0.6,
+                        cv::Scalar(0, 252, 124), 1, cv::LINE_AA);
+        }
+    }
+}
+
+struct Detection
+{
+    aruco_markers::MarkerCorners corners;
+    std::vector<int> ids;
+    std::vector<cv::Vec3d> rvecs, tvecs;
+};
+
+/**
+ * Times identification of random candidate bit patterns with
+ * cv::aruco::Dictionary::identify and with packed codewords.
+ */
+std::string benchIdentify(const cv::Ptr<cv::aruco::Dictionary>& dictionary,
+                          double error_rate, cv::RNG& rng)
+{
+    aruco_markers::MarkerIdentifier identifier(dictionary);
+    std::vector<cv::Mat> candidates = candidateBits(dictionary, 1000, rng);
+    std::vector<int> opencv_ids(candidates.size()), packed_ids(
+        candidates.size());
+    int rotation;
+    int64_t start = cv::getTickCount();
+    for (size_t i = 0; i < candidates.size(); i++)
+        dictionary->identify(candidates[i], opencv_ids[i], rotation,
+                             error_rate);
+    double opencv_us = elapsedMs(start) * 1000.0 / candidates.size();
+    start = cv::getTickCount();
+    for (size_t i = 0; i < candidates.size(); i++)
+        identifier.identify(candidates[i], packed_ids[i], rotation,
+                            error_rate);
+    double packed_us = elapsedMs(start) * 1000.0 / candidates.size();
+    int agree = 0;
+    for (size_t i = 0; i < candidates.size(); i++)
+        agree += opencv_ids[i] == packed_ids[i];
+
+    return cv::format(
+        "\"identify_opencv_us\":%.4f,\"identify_packed_us\":%.4f,"
+        "\"identify_agreement\":%.4f",
+        opencv_us, packed_us,
+        static_cast<double>(agree) / candidates.size());
+}
+
+/**
+ * Times the threshold sweep detectMarkers runs internally, with
+ * cv::adaptiveThreshold per window and from a shared integral image.
+ */
+std::string benchThreshold(const std::vector<Scene>& scenes,
+                           const cv::aruco::DetectorParameters& params)
+{
+    std::vector<int> windows = aruco_markers::thresholdWindowSizes(params);
+    std::vector<double> opencv_ms, shared_ms;
+    double mismatch = 0;
+    for (size_t f = 0; f < scenes.size(); f++) {
+        cv::Mat gray, binary, difference;
+        cv::cvtColor(scenes[f].image, gray, cv::COLOR_BGR2GRAY);
+        std::vector<cv::Mat> binaries;
+
+        int64_t start = cv::getTickCount();
+        for (size_t w = 0; w < windows.size(); w++)
+            cv::adaptiveThreshold(gray, binary, 255,
+                                  cv::ADAPTIVE_THRESH_MEAN_C,
+                                  cv::THRESH_BINARY_INV, windows[w],
+                                  params.adaptiveThreshConstant);
+        opencv_ms.push_back(elapsedMs(start));
+
+        start = cv::getTickCount();
+        aruco_markers::thresholdWindows(gray, windows,
+                                        params.adaptiveThreshConstant,
+                                        binaries);
+        shared_ms.push_back(elapsedMs(start));
+
+        if (f == 0 && !windows.empty()) {
+            cv::compare(binary, binaries.back(), difference, cv::CMP_NE);
+            mismatch = static_cast<double>(cv::countNonZero(difference)) /
+                       difference.total();
+        }
+    }
+
+    return cv::format(
+        "\"threshold_windows\":%d,\"threshold_opencv_ms\":%s,"
+        "\"threshold_shared_ms\":%s,\"threshold_mismatch\":%.6f",
+        static_cast<int>(windows.size()),
+        toJson(summarize(opencv_ms)).c_str(),
+        toJson(summarize(shared_ms)).c_str(), mismatch);
+}
+
+/**
+ * Times turning a YUYV camera frame into what detection gets: BGR as the
+ * backend decodes it by default, or the luma plane alone with --gray, and
+ * detection on the luma plane.
+ */
+std::string benchCapture(const std::vector<Scene>& scenes,
+                         const aruco_markers::MarkerDetector& detector)
+{
+    std::vector<double> to_bgr_ms, to_luma_ms, detect_luma_ms;
+    for (size_t f = 0; f < scenes.size(); f++) {
+        cv::Mat gray, bgr, luma;
+        cv::cvtColor(scenes[f].image, gray, cv::COLOR_BGR2GRAY);
+        cv::Mat chroma(gray.size(), CV_8UC1, cv::Scalar(128)), yuyv;
+        std::vector<cv::Mat> planes;
+        planes.push_back(gray);
+        planes.push_back(chroma);
+        cv::merge(planes, yuyv);
+
+        int64_t start = cv::getTickCount();
+        cv::cvtColor(yuyv, bgr, cv::COLOR_YUV2BGR_YUYV);
+        to_bgr_ms.push_back(elapsedMs(start));
+
+        start = cv::getTickCount();
+        cv::cvtColor(yuyv, luma, cv::COLOR_YUV2GRAY_YUYV);
+        to_luma_ms.push_back(elapsedMs(start));
+
+        aruco_markers::MarkerCorners corners;
+        std::vector<int> ids;
+        start = cv::getTickCount();
+        detector.detect(luma, corners, ids);
+        detect_luma_ms.push_back(elapsedMs(start));
+    }
+
+    return cv::format(
+        "\"yuyv_to_bgr_ms\":%s,\"yuyv_to_luma_ms\":%s,"
+        "\"detect_luma_ms\":%s",
+        toJson(summarize(to_bgr_ms)).c_str(),
+        toJson(summarize(to_luma_ms)).c_str(),
+        toJson(summarize(detect_luma_ms)).c_str());
+}
+
+/**
+ * Times a stable scene: every frame detected again with parameters
+ * narrowed to what its first detection found.
+ */
+std::string benchTuned(const std::vector<Scene>& scenes,
+                       const aruco_markers::MarkerDetector& detector)
+{
+    std::vector<double> detect_tuned_ms;
+    size_t tuned_found = 0, untuned_found = 0;
+    for (size_t f = 0; f < scenes.size(); f++) {
+        aruco_markers::DetectorAutoTuner tuner(detector, 1000);
+        aruco_markers::MarkerCorners corners;
+        std::vector<int> ids;
+        cv::Ptr<cv::aruco::DetectorParameters> used = tuner.next();
+        detector.detect(scenes[f].image, corners, ids, used);
+        tuner.update(used, corners, scenes[f].image.size());
+        untuned_found += ids.size();
+
+        used = tuner.next();
+        int64_t start = cv::getTickCount();
+        detector.detect(scenes[f].image, corners, ids, used);
+        detect_tuned_ms.push_back(elapsedMs(start));
+        tuned_found += ids.size();
+    }
+
+    return cv::format(
+        "\"detect_tuned_ms\":%s,\"tuned_recall\":%.4f",
+        toJson(summarize(detect_tuned_ms)).c_str(),
+        untuned_found ? static_cast<double>(tuned_found) / untuned_found
+                      : 1.0);
+}
+
+/**
+ * Times detection and pose of every scene, with OpenCV and with the
+ * batched solver, and compares the poses to the rendered ones. Keeps the
+ * detections for benchOverlay().
+ */
+std::string benchPipeline(const std::vector<Scene>& scenes,
+                          const aruco_markers::MarkerDetector& detector,
+                          const cv::Mat& camera_matrix, float marker_length,
+                          std::vector<Detection>& detections)
+{
+    std::vector<double> detect_ms, pose_ms, total_ms;
+    std::vector<double> pose_batched_ms, pose_batched_difference;
+    aruco_markers::SquarePoseSolver pose_solver(marker_length, camera_matrix,
+                                                cv::Mat());
+    std::vector<double> translation_error, rotation_error;
+    size_t expected = 0, found = 0, false_positives = 0;
+
+    detections.resize(scenes.size());
+    for (size_t f = 0; f < scenes.size(); f++) {
+        const Scene& scene = scenes[f];
+        Detection& detection = detections[f];
+        aruco_markers::MarkerCorners& corners = detection.corners;
+        std::vector<int>& ids = detection.ids;
+        std::vector<cv::Vec3d>& rvecs = detection.rvecs;
+        std::vector<cv::Vec3d>& tvecs = detection.tvecs;
+
+        int64_t start = cv::getTickCount();
+        detector.detect(scene.image, corners, ids);
+        detect_ms.push_back(elapsedMs(start));
+
+        int64_t pose_start = cv::getTickCount();
+        if (!ids.empty())
+            cv::aruco::estimatePoseSingleMarkers(corners, marker_length,
+                                                 camera_matrix, cv::noArray(),
+                                                 rvecs, tvecs);
+        pose_ms.push_back(elapsedMs(pose_start));
+        total_ms.push_back(elapsedMs(start));
+
+        // scenes are unrelated, so the batched solver runs without warm start
+        std::vector<cv::Vec3d> batched_rvecs, batched_tvecs;
+        pose_start = cv::getTickCount();
+        pose_solver.solve(corners, ids, batched_rvecs, batched_tvecs);
+        pose_batched_ms.push_back(elapsedMs(pose_start));
+        for (size_t i = 0; i < ids.size(); i++)
+            pose_batched_difference.push_back(cv::norm(batched_tvecs[i] -
+                                                       tvecs[i]));
+
+        // markers are unique per frame unless there are more markers than
+        // the dictionary holds; match each detection to the nearest one
+        expected += scene.ids.size();
+        for (size_t i = 0; i < ids.size(); i++) {
+            int best = -1;
+            double best_distance = 0;
+            for (size_t j = 0; j < scene.ids.size(); j++) {
+                if (scene.ids[j] != ids[i])
+                    continue;
+                double distance = cv::norm(scene.tvecs[j] - tvecs[i]);
+                if (best < 0 || distance < best_distance) {
+                    best = static_cast<int>(j);
+                    best_distance = distance;
+                }
+            }
+            if (best < 0) {
+                false_positives++;
+                continue;
+            }
+            found++;
+            translation_error.push_back(best_distance);
+            rotation_error.push_back(rotationErrorDeg(scene.rvecs[best],
+                                                      rvecs[i]));
+        }
+    }
+    // throughput of detection and pose only, without the comparisons
+    double run_seconds = 0;
+    for (size_t i = 0; i < total_ms.size(); i++)
+        run_seconds += total_ms[i] / 1000.0;
+
+    return cv::format(
+        "\"detect_ms\":%s,\"pose_ms\":%s,\"total_ms\":%s,\"fps\":%.2f,"
+        "\"pose_batched_ms\":%s,\"pose_batched_difference_m\":%s,"
+        "\"recall\":%.4f,\"false_positives\":%d,"
+        "\"translation_error_m\":%s,\"rotation_error_deg\":%s",
+        toJson(summarize(detect_ms)).c_str(),
+        toJson(summarize(pose_ms)).c_str(),
+        toJson(summarize(total_ms)).c_str(),
+        run_seconds > 0 ? scenes.size() / run_seconds : 0.0,
+        toJson(summarize(pose_batched_ms)).c_str(),
+        toJson(summarize(pose_batched_difference)).c_str(),
+        expected ? static_cast<double>(found) / expected : 0.0,
+        static_cast<int>(false_positives),
+        toJson(summarize(translation_error)).c_str(),
+        toJson(summarize(rotation_error)).c_str());
+}
+
+/**
+ * Times the pose overlay of the detected scenes, drawn marker by marker
+ * and batched by PoseOverlay.
+ */
+std::string benchOverlay(const std::vector<Scene>& scenes,
+                         const std::vector<Detection>& detections,
+                         const cv::Mat& camera_matrix, float marker_length)
+{
+    aruco_markers::PoseOverlay overlay(aruco_markers::PoseOverlay::AXES,
+                                       marker_length, camera_matrix,
+                                       cv::Mat());
+    std::vector<double> opencv_ms, batched_ms;
+    cv::Mat canvas;
+    for (size_t f = 0; f < scenes.size(); f++) {
+        const Detection& d = detections[f];
+        if (d.ids.empty())
+            continue;
+        scenes[f].image.copyTo(canvas);
+        int64_t start = cv::getTickCount();
+        drawOverlayPerMarker(canvas, camera_matrix, d.corners, d.ids,
+                             d.rvecs, d.tvecs);
+        opencv_ms.push_back(elapsedMs(start));
+        scenes[f].image.copyTo(canvas);
+        start = cv::getTickCount();
+        overlay.draw(canvas, d.corners, d.ids, d.rvecs, d.tvecs);
+        batched_ms.push_back(elapsedMs(start));
+    }
+
+    return cv::format(
+        "\"overlay_opencv_ms\":%s,\"overlay_batched_ms\":%s",
+        toJson(summarize(opencv_ms)).c_str(),
+        toJson(summarize(batched_ms)).c_str());
+}
+
+std::string runConfig(const Config& config, int frames, float marker_length,
+                      int decimation, int tiles, int overlap,
+                      const cv::Ptr<cv::aruco::DetectorParameters>& params,
+                      cv::RNG& rng)
+{
+    cv::Ptr<cv::aruco::Dictionary> dictionary =
+        cv::aruco::getPredefinedDictionary(
+        cv::aruco::PREDEFINED_DICTIONARY_NAME(config.dictionary));
+    aruco_markers::MarkerDetector detector(dictionary, params);
+    detector.setDecimation(decimation);
+    detector.setTiling(tiles, overlap);
+    cv::Mat camera_matrix = syntheticCameraMatrix(config.size);
+
+    std::vector<Scene> scenes;
+    for (int i = 0; i < frames; i++)
+        scenes.push_back(renderScene(config, dictionary, camera_matrix,
+                                     marker_length, rng));
+
+    // one JSON fragment per stage, in the order of the output object
+    std::string identify = benchIdentify(dictionary,
+                                         params->errorCorrectionRate, rng);
+    std::string threshold = benchThreshold(scenes, *params);
+    std::string capture = benchCapture(scenes, detector);
+    std::string tuned = benchTuned(scenes, detector);
+    std::vector<Detection> detections;
+    std::string pipeline = benchPipeline(scenes, detector, camera_matrix,
+                                         marker_length, detections);
+    std::string overlay = benchOverlay(scenes, detections, camera_matrix,
+                                       marker_length);
+
+    return cv::format(
+        "{\"width\":%d,\"height\":%d,\"dictionary\":%d,\"markers\":%d,"
+        "\"blur\":%.2f,\"noise\":%.2f,\"frames\":%d,",
+        config.size.width, config.size.height, config.dictionary,
+        config.markers, config.blur, config.noise, frames) +
+        pipeline + "," + threshold + "," + identify + "," + overlay + "," +
+        capture + "," + tuned + "}";
+}
+}
+
+int main(int argc, char **argv)
+{
+    cv::CommandLineParser parser(argc, argv, keys);
+    parser.about(about);
+
+    if (parser.get<bool>("h")) {
+        parser.printMessage();
+        return 0;
+    }
+
+    std::vector<cv::Size> sizes;
+    std::vector<int> dictionaries, marker_counts;
+    std::vector<double> blurs, noises;
+    bool lists_ok = parseSizes(parser.get<cv::String>("res"), sizes) &&
+                    parseList(parser.get<cv::String>("d"), dictionaries) &&
+                    parseList(parser.get<cv::String>("n"), marker_counts) &&
+                    parseList(parser.get<cv::String>("blur"), blurs) &&
+                    parseList(parser.get<cv::String>("noise"), noises);
+    int frames = parser.get<int>("frames");
+    float marker_length = parser.get<float>("l");
+    int decimation = parser.get<int>("dec");
+    int tiles = parser.get<int>("tiles");
+    int overlap = parser.get<int>("overlap");
+    int seed = parser.get<int>("seed");
+
+    cv::Ptr<cv::aruco::DetectorParameters> params =
+        cv::aruco::DetectorParameters::create();
+    if (parser.has("dp") &&
+        !aruco_markers::readDetectorParameters(parser.get<cv::String>("dp"),
+                                               params)) {
+        std::cerr << "failed to read detector parameters: "
+                  << parser.get<cv::String>("dp") << std::endl;
+        return 1;
+    }
+
+    if (!parser.check()) {
+        parser.printErrors();
+        return 1;
+    }
+
+    if (!lists_ok || frames < 1 || marker_length <= 0 || decimation < 1 ||
+        tiles < 1 || overlap < 0) {
+        parser.printMessage();
+        return 1;
+    }
+
+    std::FILE* out = stdout;
+    if (parser.has("o")) {
+        cv::String path = parser.get<cv::String>("o");
+        out = std::fopen(path.c_str(), "w");
+        if (!out) {
+            std::cerr << "failed to open output file: " << path << std::endl;
+            return 1;
+        }
+    }
+
+    cv::RNG rng(seed);
+    std::fprintf(out, "{\"opencv\":\"%s\",\"threads\":%d,\"results\":[",
+                 CV_VERSION, cv::getNumThreads());
+    bool first = true;
+    for (size_t s = 0; s < sizes.size(); s++)
+    for (size_t d = 0; d < dictionaries.size(); d++)
+    for (size_t n = 0; n < marker_counts.size(); n++)
+    for (size_t b = 0; b < blurs.size(); b++)
+    for (size_t k = 0; k < noises.size(); k++) {
+        Config config = { sizes[s], dictionaries[d], marker_counts[n],
+                          blurs[b], noises[k] };
+        std::cerr << "running " << config.size << " dictionary "
+                  << config.dictionary << ", " << config.markers
+                  << " markers, blur " << config.blur << ", noise "
+                  << config.noise << std::endl;
+        std::string result = runConfig(config, frames, marker_length,
+                                       decimation, tiles, overlap, params,
+                                       rng);
+        std::fprintf(out, "%s\n%s", first ? "" : ",", result.c_str());
+        first = false;
+    }
+    std::fprintf(out, "\n]}\n");
+
+    if (out != stdout)
+        std::fclose(out);
+
+    return 0;
+}
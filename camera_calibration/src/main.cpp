@@ -41,10 +41,20 @@ the use of this software, even if advised of the possibility of such damage.
 #include <opencv2/calib3d.hpp>
 #include <opencv2/aruco.hpp>
 #include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <cctype>
 #include <vector>
 #include <iostream>
+#include <cstdio>
 #include <ctime>
 
+#include "aruco_markers/calibration.hpp"
+#include "aruco_markers/detection.hpp"
+#include "aruco_markers/frame_selection.hpp"
+#include "aruco_markers/incremental_calibration.hpp"
+#include "aruco_markers/pipeline.hpp"
+
 using namespace std;
 using namespace cv;
 
@@ -54,7 +64,12 @@ const char* about =
         "Calibration using a ArUco Planar Grid board\n"
         "  To capture a frame for calibration, press 'c',\n"
         "  If input comes from video, press any key for next frame\n"
-        "  To finish capturing, press 'ESC' key and calibration starts.\n";
+        "  To finish capturing, press 'ESC' key and calibration starts.\n"
+        "  With --dir or --offline all frames of an image directory or video\n"
+        "  are searched for the board without a window, and a well spread\n"
+        "  subset of at most --mf of them is used for calibration.\n"
+        "  With --live the camera is calibrated after every capture, and\n"
+        "  capturing stops once the estimate has converged.\n";
 const char* keys  =
         "{w        |       | Number of squares in X direction }"
         "{h        |       | Number of squares in Y direction }"
@@ -72,36 +87,118 @@ const char* keys  =
         "{zt       | false | Assume zero tangential distortion }"
         "{a        |       | Fix aspect ratio (fx/fy) to this value }"
         "{pc       | false | Fix the principal point at the center }"
-        "{waitkey  | 10    | Time in milliseconds to wait for key press }";
+        "{waitkey  | 10    | Time in milliseconds to wait for key press }"
+        "{dir      |       | Calibrate offline from the images in this directory }"
+        "{offline  | false | Calibrate offline from every frame of the video given by -v }"
+        "{mf       | 40    | Maximum number of frames used by offline calibration }"
+        "{j        | 0     | Threads detecting frames offline, 0 for all cores }"
+        "{live     | false | Calibrate in the background after each capture and stop once converged }"
+        "{res      |       | Capture resolution requested from the camera, e.g. 1280x720 }"
+        "{profiles |       | Also add the result to this calibration profile file, replacing the profile "
+        "of the same resolution }";
 }
 
 /**
  */
-static bool readDetectorParameters(string filename, Ptr<aruco::DetectorParameters> &params) {
-    FileStorage fs(filename, FileStorage::READ);
-    if(!fs.isOpened())
-        return false;
-    fs["adaptiveThreshWinSizeMin"] >> params->adaptiveThreshWinSizeMin;
-    fs["adaptiveThreshWinSizeMax"] >> params->adaptiveThreshWinSizeMax;
-    fs["adaptiveThreshWinSizeStep"] >> params->adaptiveThreshWinSizeStep;
-    fs["adaptiveThreshConstant"] >> params->adaptiveThreshConstant;
-    fs["minMarkerPerimeterRate"] >> params->minMarkerPerimeterRate;
-    fs["maxMarkerPerimeterRate"] >> params->maxMarkerPerimeterRate;
-    fs["polygonalApproxAccuracyRate"] >> params->polygonalApproxAccuracyRate;
-    fs["minCornerDistanceRate"] >> params->minCornerDistanceRate;
-    fs["minDistanceToBorder"] >> params->minDistanceToBorder;
-    fs["minMarkerDistanceRate"] >> params->minMarkerDistanceRate;
-    fs["cornerRefinementMethod"] >> params->cornerRefinementMethod;
-    fs["cornerRefinementWinSize"] >> params->cornerRefinementWinSize;
-    fs["cornerRefinementMaxIterations"] >> params->cornerRefinementMaxIterations;
-    fs["cornerRefinementMinAccuracy"] >> params->cornerRefinementMinAccuracy;
-    fs["markerBorderBits"] >> params->markerBorderBits;
-    fs["perspectiveRemovePixelPerCell"] >> params->perspectiveRemovePixelPerCell;
-    fs["perspectiveRemoveIgnoredMarginPerCell"] >> params->perspectiveRemoveIgnoredMarginPerCell;
-    fs["maxErroneousBitsInBorderRate"] >> params->maxErroneousBitsInBorderRate;
-    fs["minOtsuStdDev"] >> params->minOtsuStdDev;
-    fs["errorCorrectionRate"] >> params->errorCorrectionRate;
-    return true;
+static void listImages(const string &directory, vector< String > &files) {
+    static const char* extensions[] = { ".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff", ".pgm", ".ppm" };
+    vector< String > all;
+    glob(directory, all, false);
+    sort(all.begin(), all.end());
+    for(size_t i = 0; i < all.size(); i++) {
+        string name = all[i];
+        transform(name.begin(), name.end(), name.begin(), ::tolower);
+        for(size_t e = 0; e < sizeof(extensions) / sizeof(extensions[0]); e++) {
+            string extension = extensions[e];
+            if(name.size() > extension.size() &&
+               name.compare(name.size() - extension.size(), extension.size(), extension) == 0) {
+                files.push_back(all[i]);
+                break;
+            }
+        }
+    }
+}
+
+
+
+/**
+ * Searches every frame of a video or every image of a list for the board
+ * on all cores and keeps a well spread subset of at most maxFrames frames.
+ */
+static void collectFramesOffline(VideoCapture &inputVideo, const vector< String > &files,
+                                 const Ptr<aruco::Dictionary> &dictionary, const Ptr<aruco::Board> &board,
+                                 const Ptr<aruco::DetectorParameters> &detectorParams, bool refindStrategy,
+                                 int workers, int maxFrames,
+                                 vector< vector< vector< Point2f > > > &allCorners,
+                                 vector< vector< int > > &allIds, Size &imgSize) {
+    auto detect = [&](const Mat &image, aruco_markers::CalibrationView &view) {
+        vector< vector< Point2f > > rejected;
+        aruco::detectMarkers(image, dictionary, view.corners, view.ids, detectorParams, rejected);
+        if(refindStrategy) aruco::refineDetectedMarkers(image, board, view.corners, view.ids, rejected);
+    };
+
+    vector< aruco_markers::CalibrationView > views;
+    vector< Size > sizes;
+    if(!files.empty()) {
+        // images decode independently, read and search each on its own core
+        views.resize(files.size());
+        sizes.resize(files.size());
+        // the thread count is global, restore it for the calibration itself
+        int previousThreads = getNumThreads();
+        if(workers > 0) setNumThreads(workers);
+        parallel_for_(Range(0, (int)files.size()), [&](const Range &range) {
+            for(int i = range.start; i < range.end; i++) {
+                Mat image = imread(files[i]);
+                if(image.empty()) continue;
+                sizes[i] = image.size();
+                detect(image, views[i]);
+            }
+        });
+        if(workers > 0) setNumThreads(previousThreads);
+    } else {
+        // a video decodes in order, frames are searched in parallel
+        aruco_markers::Pipeline pipeline;
+        pipeline.setWorkers(workers);
+        pipeline.setCapture([&](Mat &image) {
+            return inputVideo.grab() && inputVideo.retrieve(image);
+        });
+        pipeline.setDetection([&](aruco_markers::Frame &frame) {
+            aruco_markers::CalibrationView view;
+            detect(frame.image, view);
+            frame.corners.swap(view.corners);
+            frame.ids.swap(view.ids);
+        });
+        pipeline.setOutput([&](aruco_markers::Frame &frame) {
+            aruco_markers::CalibrationView view;
+            view.corners.swap(frame.corners);
+            view.ids.swap(frame.ids);
+            views.push_back(view);
+            sizes.push_back(frame.image.size());
+            return true;
+        });
+        pipeline.run();
+    }
+
+    // calibration needs a single resolution, take the first one seen
+    int found = 0;
+    for(size_t i = 0; i < views.size(); i++) {
+        if(sizes[i].area() == 0) continue;
+        if(imgSize.area() == 0) imgSize = sizes[i];
+        if(sizes[i] != imgSize) {
+            cerr << "Skipping frame " << i << " of size " << sizes[i] << endl;
+            views[i] = aruco_markers::CalibrationView();
+        }
+        if(!views[i].ids.empty()) found++;
+    }
+
+    vector< size_t > selected =
+        aruco_markers::selectCalibrationViews(views, board, imgSize, maxFrames);
+    cout << "Board found in " << found << " of " << views.size() << " frames, using "
+         << selected.size() << " of them" << endl;
+    for(size_t i = 0; i < selected.size(); i++) {
+        allCorners.push_back(views[selected[i]].corners);
+        allIds.push_back(views[selected[i]].ids);
+    }
 }
 
 
@@ -176,7 +273,8 @@ int main(int argc, char *argv[]) {
 
     Ptr<aruco::DetectorParameters> detectorParams = aruco::DetectorParameters::create();
     if(parser.has("dp")) {
-        bool readOk = readDetectorParameters(parser.get<string>("dp"), detectorParams);
+        bool readOk = aruco_markers::readDetectorParameters(parser.get<string>("dp"),
+                                                            detectorParams);
         if(!readOk) {
             cerr << "Invalid detector parameters file" << endl;
             return 0;
@@ -193,26 +291,83 @@ int main(int argc, char *argv[]) {
 
     int waitTime = parser.get<int>("waitkey");
 
+    String imageDir;
+    if(parser.has("dir")) {
+        imageDir = parser.get<String>("dir");
+    }
+    bool offline = !imageDir.empty() || parser.get<bool>("offline");
+    int maxFrames = parser.get<int>("mf");
+    int workers = parser.get<int>("j");
+    bool live = parser.get<bool>("live") && !offline;
+    string profilesFile = parser.get<string>("profiles");
+
     if(!parser.check()) {
         parser.printErrors();
         return 0;
     }
 
+    if(offline && imageDir.empty() && video.empty()) {
+        cerr << "Offline calibration needs a video (-v) or an image directory (--dir)" << endl;
+        return 1;
+    }
+
+    // a missing file starts a new set of profiles; one that exists but
+    // cannot be read must not be overwritten with only this calibration
+    aruco_markers::CalibrationProfiles profiles;
+    if(!profilesFile.empty()) {
+        FILE *existing = fopen(profilesFile.c_str(), "rb");
+        if(existing) {
+            fclose(existing);
+            if(!profiles.load(profilesFile)) {
+                cerr << "Cannot read profile file " << profilesFile << endl;
+                return 1;
+            }
+        }
+    }
+
+    if(maxFrames < 1 || workers < 0) {
+        cerr << "mf must be at least 1 and j must not be negative" << endl;
+        return 1;
+    }
+
     String videoInput;
     VideoCapture inputVideo;
+    vector< String > imageFiles;
 
-    bool opened;
-    if(!video.empty()) {
-        videoInput = video;
-        opened = inputVideo.open(video);
+    if(!imageDir.empty()) {
+        listImages(imageDir, imageFiles);
+        if(imageFiles.empty()) {
+            cerr << "No images found in " << imageDir << endl;
+            return 1;
+        }
     } else {
-        videoInput = camId;
-        opened = inputVideo.open(camId);
-    }
+        bool opened;
+        if(!video.empty()) {
+            videoInput = video;
+            opened = inputVideo.open(video);
+        } else {
+            videoInput = camId;
+            opened = inputVideo.open(camId);
+        }
 
-    if (!opened) {
-        std::cerr << "failed to open video input: " << videoInput << std::endl;
-        return 1;
+        if (!opened) {
+            std::cerr << "failed to open video input: " << videoInput << std::endl;
+            return 1;
+        }
+
+        // calibrate each resolution the camera will be run at
+        string resolution = parser.get<string>("res");
+        if(!resolution.empty()) {
+            Size size;
+            if(!aruco_markers::parseResolution(resolution, size)) {
+                cerr << "resolution must be given as <width>x<height>" << endl;
+                return 1;
+            }
+            inputVideo.set(CAP_PROP_FRAME_WIDTH, size.width);
+            inputVideo.set(CAP_PROP_FRAME_HEIGHT, size.height);
+            cout << "Capturing at " << inputVideo.get(CAP_PROP_FRAME_WIDTH) << "x"
+                 << inputVideo.get(CAP_PROP_FRAME_HEIGHT) << endl;
+        }
     }
 
     Ptr<aruco::Dictionary> dictionary =
@@ -228,7 +383,21 @@ int main(int argc, char *argv[]) {
     vector< vector< int > > allIds;
     Size imgSize;
 
-    while(inputVideo.grab()) {
+    Mat cameraMatrix, distCoeffs;
+    if(calibrationFlags & CALIB_FIX_ASPECT_RATIO) {
+        cameraMatrix = Mat::eye(3, 3, CV_64F);
+        cameraMatrix.at< double >(0, 0) = aspectRatio;
+    }
+
+    // refines the calibration while frames are still being captured
+    Ptr<aruco_markers::IncrementalCalibrator> liveCalibrator;
+
+    if(offline) {
+        collectFramesOffline(inputVideo, imageFiles, dictionary, board, detectorParams,
+                             refindStrategy, workers, maxFrames, allCorners, allIds, imgSize);
+    }
+
+    while(!offline && inputVideo.grab()) {
         Mat image, imageCopy;
         inputVideo.retrieve(image);
 
@@ -247,6 +416,22 @@ int main(int argc, char *argv[]) {
         putText(imageCopy, "Press 'c' to add current frame. 'ESC' to finish and calibrate",
                 Point(10, 20), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(255, 0, 0), 2);
 
+        // running error and standard deviation of the intrinsics
+        aruco_markers::CalibrationEstimate estimate;
+        if(liveCalibrator && liveCalibrator->estimate(estimate)) {
+            const Mat &k = estimate.camera_matrix;
+            const Mat &sd = estimate.std_deviations;
+            putText(imageCopy, format("%d frames, error %.3f px%s", estimate.views, estimate.error,
+                                      estimate.converged ? ", converged" : ""),
+                    Point(10, 40), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(255, 0, 0), 2);
+            putText(imageCopy, format("fx %.1f+-%.2f fy %.1f+-%.2f cx %.1f+-%.2f cy %.1f+-%.2f",
+                                      k.at< double >(0, 0), sd.at< double >(0),
+                                      k.at< double >(1, 1), sd.at< double >(1),
+                                      k.at< double >(0, 2), sd.at< double >(2),
+                                      k.at< double >(1, 2), sd.at< double >(3)),
+                    Point(10, 60), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(255, 0, 0), 2);
+        }
+
         imshow("out", imageCopy);
         char key = (char)waitKey(waitTime);
         if(key == 27) break;
@@ -255,6 +440,19 @@ int main(int argc, char *argv[]) {
             allCorners.push_back(corners);
             allIds.push_back(ids);
             imgSize = image.size();
+            if(live) {
+                if(!liveCalibrator)
+                    liveCalibrator = makePtr<aruco_markers::IncrementalCalibrator>(
+                        board, imgSize, calibrationFlags, cameraMatrix);
+                aruco_markers::CalibrationView view;
+                view.corners = corners;
+                view.ids = ids;
+                liveCalibrator->addView(view);
+            }
+        }
+        if(estimate.converged) {
+            cout << "Calibration converged after " << estimate.views << " frames" << endl;
+            break;
         }
     }
 
@@ -263,15 +461,9 @@ int main(int argc, char *argv[]) {
         return 0;
     }
 
-    Mat cameraMatrix, distCoeffs;
     vector< Mat > rvecs, tvecs;
     double repError;
 
-    if(calibrationFlags & CALIB_FIX_ASPECT_RATIO) {
-        cameraMatrix = Mat::eye(3, 3, CV_64F);
-        cameraMatrix.at< double >(0, 0) = aspectRatio;
-    }
-
     // prepare data for calibration
     vector< vector< Point2f > > allCornersConcatenated;
     vector< int > allIdsConcatenated;
@@ -284,10 +476,22 @@ int main(int argc, char *argv[]) {
             allIdsConcatenated.push_back(allIds[i][j]);
         }
     }
-    // calibrate camera
-    repError = aruco::calibrateCameraAruco(allCornersConcatenated, allIdsConcatenated,
-                                           markerCounterPerFrame, board, imgSize, cameraMatrix,
-                                           distCoeffs, rvecs, tvecs, calibrationFlags);
+    // use the live estimate only when its last run covers every capture
+    aruco_markers::CalibrationEstimate liveEstimate;
+    bool liveOk = liveCalibrator && liveCalibrator->finish(liveEstimate);
+    if(liveCalibrator && !liveOk && !liveCalibrator->failure().empty())
+        cerr << "Live calibration failed, calibrating again: "
+             << liveCalibrator->failure() << endl;
+    if(liveOk) {
+        cameraMatrix = liveEstimate.camera_matrix;
+        distCoeffs = liveEstimate.dist_coeffs;
+        repError = liveEstimate.error;
+    } else {
+        // calibrate camera
+        repError = aruco::calibrateCameraAruco(allCornersConcatenated, allIdsConcatenated,
+                                               markerCounterPerFrame, board, imgSize, cameraMatrix,
+                                               distCoeffs, rvecs, tvecs, calibrationFlags);
+    }
 
     bool saveOk = saveCameraParams(outputFile, imgSize, aspectRatio, calibrationFlags, cameraMatrix,
                                    distCoeffs, repError);
@@ -300,5 +504,19 @@ int main(int argc, char *argv[]) {
     cout << "Rep Error: " << repError << endl;
     cout << "Calibration saved to " << outputFile << endl;
 
+    if(!profilesFile.empty()) {
+        aruco_markers::CameraIntrinsics intrinsics;
+        intrinsics.size = imgSize;
+        cameraMatrix.convertTo(intrinsics.camera_matrix, CV_64F);
+        distCoeffs.reshape(1, 1).convertTo(intrinsics.dist_coeffs, CV_64F);
+        profiles.add(intrinsics);
+        if(!profiles.save(profilesFile)) {
+            cerr << "Cannot save profile file " << profilesFile << endl;
+            return 1;
+        }
+        cout << "Profile for " << imgSize.width << "x" << imgSize.height << " saved to "
+             << profilesFile << " (" << profiles.profiles().size() << " profiles)" << endl;
+    }
+
     return 0;
 }
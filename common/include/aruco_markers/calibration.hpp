@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef ARUCO_MARKERS_CALIBRATION_HPP
+#define ARUCO_MARKERS_CALIBRATION_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "aruco_markers/roi_tracker.hpp"
+
+
+namespace aruco_markers {
+
+/**
+ * Hashes the file content (64-bit FNV-1a). Returns false when the file
+ * cannot be read.
+ */
+bool hashFile(const std::string& path, uint64_t& hash);
+
+/**
+ * Camera matrix and distortion coefficients of a camera at the resolution
+ * they were calibrated at.
+ */
+struct CameraIntrinsics
+{
+    cv::Size size;
+    cv::Mat camera_matrix;   // 3x3 CV_64F
+    cv::Mat dist_coeffs;     // 1xN CV_64F
+
+    /**
+     * Intrinsics for frames of the same sensor area resampled to `size`.
+     * Focal lengths and principal point follow the pixel grid; distortion
+     * acts on normalized coordinates and stays unchanged.
+     */
+    CameraIntrinsics scaled(cv::Size size) const;
+};
+
+/**
+ * Calibrations of one camera at several capture resolutions.
+ *
+ * A profile file is either a single calibration as written by
+ * camera_calibration or a `profiles` sequence of them, each with its
+ * image_width and image_height. select() returns the intrinsics for the
+ * resolution frames actually arrive in, scaling the closest profile when
+ * there is none for that resolution, so the capture resolution can be
+ * lowered without recalibrating.
+ *
+ * Parsed profiles are cached in a binary file next to the profile file,
+ * keyed by a hash of its content like the undistortion cache, so starting
+ * a tool does not parse YAML once the cache exists.
+ */
+class CalibrationProfiles
+{
+public:
+    /**
+     * Loads the profiles from the cache or parses the file and writes the
+     * cache. Returns false when the file cannot be read or holds no valid
+     * profile; failing to write the cache is reported on stderr only.
+     */
+    bool load(const std::string& path);
+
+    bool save(const std::string& path) const;
+
+    // Adds a profile, replacing one of the same resolution.
+    void add(const CameraIntrinsics& intrinsics);
+
+    /**
+     * Intrinsics for frames of `size`: the profile of that resolution, or
+     * else the largest profile with the same aspect ratio scaled to it.
+     * A different aspect ratio means a cropped sensor mode, which scaling
+     * cannot describe. Returns the index of the profile used, or -1 when
+     * none fits. An empty size selects the largest profile as it is.
+     */
+    int select(cv::Size size, CameraIntrinsics& intrinsics) const;
+
+    const std::vector<CameraIntrinsics>& profiles() const
+    {
+        return profiles_;
+    }
+    bool empty() const { return profiles_.empty(); }
+
+    /**
+     * Cache file used for the given profile file.
+     */
+    static std::string cachePath(const std::string& path);
+
+private:
+    bool parse(const std::string& path);
+    bool readCache(const std::string& path, uint64_t hash);
+    bool writeCache(const std::string& path, uint64_t hash) const;
+
+    std::vector<CameraIntrinsics> profiles_;
+};
+
+/**
+ * Intrinsics of the profile in path that fits frames of frame_size, see
+ * CalibrationProfiles::select(). Prints the reason to stderr when there is
+ * none, and a note when the profile of another resolution is scaled.
+ */
+bool loadIntrinsics(const std::string& path, cv::Size frame_size,
+                    cv::Mat& camera_matrix, cv::Mat& dist_coeffs);
+
+/**
+ * Parses a resolution given as <width>x<height>, e.g. "1280x720".
+ */
+bool parseResolution(const std::string& text, cv::Size& size);
+
+/**
+ * Requests a resolution from the capture unless size is empty, and returns
+ * the one the capture reports frames to arrive in, which selects the
+ * calibration profile.
+ */
+cv::Size setResolution(cv::VideoCapture& capture, cv::Size size);
+
+/**
+ * Checks that a captured frame has the size calibration data was prepared
+ * for. Backends may report one size and deliver another, so a mismatch is
+ * reported on stderr and returns false for the caller to stop.
+ */
+bool checkFrameSize(const cv::Mat& frame, cv::Size expected);
+
+/**
+ * Undistortion data derived from a calibration file for one resolution.
+ *
+ * Holds the remap tables that rectify a whole image and a per-pixel lookup
+ * table from distorted pixels to normalized camera coordinates. Detected
+ * corners are undistorted with a bilinear lookup instead of the iterative
+ * cv::undistortPoints(), so pose and overlay math can use the camera
+ * matrix with zero distortion.
+ *
+ * Both tables are expensive to build at high resolutions and are cached in
+ * a binary file next to the calibration file, one per resolution. The
+ * cache stores a hash of the calibration file and is rebuilt automatically
+ * once the calibration changes.
+ */
+class UndistortionCache
+{
+public:
+    UndistortionCache();
+
+    /**
+     * Loads the tables for `size` from the cache or builds and stores them.
+     * Returns false only when the tables could not be built; failing to
+     * write the cache file is reported on stderr and otherwise ignored.
+     */
+    bool load(const std::string& calibration_path,
+              const cv::Mat& camera_matrix, const cv::Mat& dist_coeffs,
+              cv::Size size);
+
+    bool empty() const { return lut_.empty(); }
+    cv::Size size() const { return lut_.size(); }
+
+    // Camera matrix of the rectified image and points.
+    const cv::Mat& cameraMatrix() const { return camera_matrix_; }
+
+    void undistortImage(const cv::Mat& image, cv::Mat& rectified) const;
+
+    /**
+     * Maps distorted pixel coordinates to normalized camera coordinates.
+     */
+    void normalize(const MarkerCorners& corners,
+                   MarkerCorners& normalized) const;
+
+    /**
+     * Maps distorted pixel coordinates to pixel coordinates of the rectified
+     * image, i.e. normalized coordinates projected with cameraMatrix().
+     * corners and rectified may be the same object.
+     */
+    void rectify(const MarkerCorners& corners, MarkerCorners& rectified) const;
+
+    /**
+     * Cache file used for the given calibration file and resolution.
+     */
+    static std::string cachePath(const std::string& calibration_path,
+                                 cv::Size size);
+
+private:
+    cv::Point2f lookup(const cv::Point2f& pixel) const;
+    bool read(const std::string& path, uint64_t hash, cv::Size size);
+    bool write(const std::string& path, uint64_t hash) const;
+    void build(const cv::Mat& camera_matrix, const cv::Mat& dist_coeffs,
+               cv::Size size);
+
+    cv::Mat camera_matrix_;
+    cv::Mat map1_, map2_;   // CV_16SC2 / CV_16UC1 for cv::remap
+    cv::Mat lut_;           // CV_32FC2 normalized coordinates per pixel
+};
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_CALIBRATION_HPP
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef ARUCO_MARKERS_DETECTION_HPP
+#define ARUCO_MARKERS_DETECTION_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/aruco.hpp>
+#include <string>
+#include <vector>
+
+#include "aruco_markers/roi_tracker.hpp"
+
+
+namespace aruco_markers {
+
+/**
+ * Marker detection shared by the runtime tools.
+ *
+ * With a decimation factor above 1 candidates are searched on an image
+ * downscaled by that factor, and the corners found there are refined with
+ * sub-pixel accuracy on the full-resolution image. Detection cost then
+ * follows the small image while the corners, and hence the poses, keep
+ * full-resolution accuracy. When nothing is found on the small image the
+ * full-resolution image is searched as before.
+ *
+ * With tiling enabled a large frame is split into a grid of overlapping
+ * tiles that are searched in parallel. Corners are mapped back to frame
+ * coordinates and a marker seen by two neighbouring tiles is reported once.
+ * Markers are only found when they fit completely into one tile, so the
+ * overlap has to be at least the size of the largest expected marker.
+ * Perimeter limits stay relative to the whole frame, as without tiling.
+ *
+ * detect() keeps no per-call state and can be used from several threads.
+ */
+class MarkerDetector
+{
+public:
+    explicit MarkerDetector(
+        const cv::Ptr<cv::aruco::Dictionary>& dictionary,
+        const cv::Ptr<cv::aruco::DetectorParameters>& params =
+            cv::aruco::DetectorParameters::create());
+
+    void setDecimation(int factor);
+    int decimation() const { return decimation_; }
+
+    /**
+     * Splits frames into tiles x tiles parts overlapping by `overlap`
+     * pixels; 1 (the default) disables tiling. Frames whose tiles would be
+     * narrower than the overlap are not split.
+     */
+    void setTiling(int tiles, int overlap);
+    int tiles() const { return tiles_; }
+
+    const cv::Ptr<cv::aruco::Dictionary>& dictionary() const
+    {
+        return dictionary_;
+    }
+    const cv::Ptr<cv::aruco::DetectorParameters>& parameters() const
+    {
+        return params_;
+    }
+
+    void detect(const cv::Mat& image, MarkerCorners& corners,
+                std::vector<int>& ids) const;
+
+    /**
+     * Detects with the given parameters instead of the detector's own, e.g.
+     * ones narrowed per frame by a DetectorAutoTuner.
+     */
+    void detect(const cv::Mat& image, MarkerCorners& corners,
+                std::vector<int>& ids,
+                const cv::Ptr<cv::aruco::DetectorParameters>& params) const;
+
+private:
+    void detectImage(const cv::Mat& image,
+                     const cv::Ptr<cv::aruco::DetectorParameters>& params,
+                     MarkerCorners& corners, std::vector<int>& ids) const;
+    bool detectDecimated(const cv::Mat& image,
+                         const cv::Ptr<cv::aruco::DetectorParameters>& params,
+                         MarkerCorners& corners, std::vector<int>& ids) const;
+    void detectTiled(const cv::Mat& image,
+                     const cv::Ptr<cv::aruco::DetectorParameters>& params,
+                     MarkerCorners& corners, std::vector<int>& ids) const;
+
+    cv::Ptr<cv::aruco::Dictionary> dictionary_;
+    cv::Ptr<cv::aruco::DetectorParameters> params_;
+    int decimation_;
+    int tiles_;
+    int overlap_;
+};
+
+/**
+ * Reads the detector parameters present in a file, as written by
+ * cv::FileStorage, into params and keeps the others. Returns false when
+ * the file cannot be opened.
+ */
+bool readDetectorParameters(const std::string& path,
+                            cv::Ptr<cv::aruco::DetectorParameters>& params);
+
+/**
+ * Refines marker corners in place on the given image with cornerSubPix.
+ * win_size is the half side length of the search window.
+ */
+void refineCorners(const cv::Mat& image, MarkerCorners& corners,
+                   int win_size);
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_DETECTION_HPP
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_DETECTOR_TUNER_HPP
+#define ARUCO_MARKERS_DETECTOR_TUNER_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/utility.hpp>
+#include <opencv2/aruco.hpp>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "aruco_markers/detection.hpp"
+
+
+namespace aruco_markers {
+
+/**
+ * Narrows the candidate search of the detector to the marker sizes seen in
+ * recent frames.
+ *
+ * After a frame in which markers were found, the perimeter limits are
+ * narrowed to the observed perimeters widened by `margin`, and the
+ * adaptive threshold windows to the part of the base window grid that
+ * matches the observed marker cell sizes. Stable scenes then threshold
+ * fewer windows and reject more contours early. The base parameters are
+ * used again on the first frames, every rescan_interval frames so that
+ * new markers of other sizes are found, and right after a narrowed frame
+ * finds fewer markers than the one before it.
+ *
+ * next() and update() may be called from several detection threads.
+ * Returned parameters are never modified afterwards, and update() is told
+ * which parameters were used, so frames may complete out of order.
+ */
+class DetectorAutoTuner
+{
+public:
+    DetectorAutoTuner(const cv::Ptr<cv::aruco::Dictionary>& dictionary,
+                      const cv::Ptr<cv::aruco::DetectorParameters>& base,
+                      int rescan_interval = 30, double margin = 1.5);
+
+    /**
+     * Tunes the parameters and decimation of detector.
+     */
+    explicit DetectorAutoTuner(const MarkerDetector& detector,
+                               int rescan_interval = 30,
+                               double margin = 1.5);
+
+    /**
+     * Markers are searched on images downscaled by this factor, see
+     * MarkerDetector::setDecimation(); threshold windows follow it.
+     */
+    void setDecimation(int factor);
+
+    /**
+     * Parameters to detect the next frame with.
+     */
+    cv::Ptr<cv::aruco::DetectorParameters> next();
+
+    /**
+     * Reports the markers found in a frame of image_size with parameters
+     * returned by next().
+     */
+    void update(const cv::Ptr<cv::aruco::DetectorParameters>& used,
+                const MarkerCorners& corners, cv::Size image_size);
+
+    /**
+     * Detects the markers of one frame with detector, using next() and
+     * update() around it.
+     */
+    void detect(const MarkerDetector& detector, const cv::Mat& image,
+                MarkerCorners& corners, std::vector<int>& ids);
+
+    uint64_t narrowedFrames() const;
+    uint64_t fullFrames() const;
+    uint64_t misses() const;
+
+    // Writes the frame counts above as one line.
+    void report(std::ostream& out) const;
+
+private:
+    DetectorAutoTuner(const DetectorAutoTuner&);
+    DetectorAutoTuner& operator=(const DetectorAutoTuner&);
+
+    void narrow(const MarkerCorners& corners, cv::Size image_size);
+
+    cv::Ptr<cv::aruco::DetectorParameters> base_;
+    cv::Ptr<cv::aruco::DetectorParameters> narrowed_;
+    int cells_;             // marker side in cells, border included
+    int rescan_interval_;
+    double margin_;
+    int decimation_;
+
+    size_t expected_;       // markers found in the last frame
+    uint64_t frames_;
+    uint64_t narrowed_frames_;
+    uint64_t full_frames_;
+    uint64_t misses_;
+    mutable std::mutex mutex_;
+};
+
+/**
+ * Reads the dp and tune keys of a tool's command line: params from the
+ * detector parameter file, when given, and tune_interval, 0 when
+ * auto-tuning is off. Prints the reason to stderr and returns false when
+ * the file cannot be read or the interval is negative.
+ */
+bool readDetectorOptions(const cv::CommandLineParser& parser,
+                         cv::Ptr<cv::aruco::DetectorParameters>& params,
+                         int& tune_interval);
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_DETECTOR_TUNER_HPP
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef ARUCO_MARKERS_FRAME_POOL_HPP
+#define ARUCO_MARKERS_FRAME_POOL_HPP
+
+#include <opencv2/core.hpp>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+
+namespace aruco_markers {
+
+/**
+ * Ring of preallocated images reused across frames.
+ *
+ * acquire() hands out a header sharing the data of a pooled image that no
+ * one else references any more. Capturing into that header with
+ * VideoCapture::retrieve() fills the pooled buffer in place, so steady
+ * state capture allocates nothing. A buffer goes back to the pool as soon
+ * as the last cv::Mat referring to it is released, wherever the frame
+ * ended up, so consumers need no explicit release call.
+ *
+ * When every pooled buffer is in use and the pool is at capacity a plain
+ * image is allocated instead and counted as a miss.
+ */
+class FramePool
+{
+public:
+    explicit FramePool(size_t capacity = 8);
+
+    void setCapacity(size_t capacity);
+
+    /**
+     * Returns an image of the given size and type backed by a free pooled
+     * buffer, or an empty image when the size is empty.
+     */
+    cv::Mat acquire(cv::Size size, int type);
+
+    size_t allocated() const;
+    size_t misses() const;
+
+private:
+    size_t capacity_;
+    size_t next_;
+    size_t misses_;
+    std::vector<cv::Mat> buffers_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_FRAME_POOL_HPP
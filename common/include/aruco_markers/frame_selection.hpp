@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_FRAME_SELECTION_HPP
+#define ARUCO_MARKERS_FRAME_SELECTION_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/aruco.hpp>
+#include <vector>
+
+#include "aruco_markers/roi_tracker.hpp"
+
+
+namespace aruco_markers {
+
+/**
+ * Markers of a calibration board detected in one frame.
+ */
+struct CalibrationView
+{
+    MarkerCorners corners;
+    std::vector<int> ids;
+};
+
+/**
+ * Picks at most max_views well spread views for camera calibration.
+ *
+ * Views are chosen greedily. Each step takes the view that adds the most
+ * of three things: image coverage (grid cells holding detected corners,
+ * with diminishing credit for cells covered before), board orientation
+ * different from the views already chosen, and the number of markers
+ * found. Orientations come from a rough pinhole guess for the camera,
+ * good enough to tell board poses apart before calibration.
+ *
+ * Returns indices into views in ascending order; views without markers
+ * are never chosen.
+ */
+std::vector<size_t> selectCalibrationViews(
+    const std::vector<CalibrationView>& views,
+    const cv::Ptr<cv::aruco::Board>& board, cv::Size image_size,
+    size_t max_views);
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_FRAME_SELECTION_HPP
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_IDENTIFICATION_HPP
+#define ARUCO_MARKERS_IDENTIFICATION_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/aruco.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+
+namespace aruco_markers {
+
+/**
+ * Identifies marker bit patterns against a dictionary.
+ *
+ * Every marker of the dictionary is packed into one 64-bit codeword per
+ * rotation when the identifier is built, so matching a candidate takes an
+ * XOR and a popcount per rotation instead of unpacking the dictionary's
+ * byte lists. Exact matches, the common case for clean images, are found
+ * with a single hash lookup. Bit packing is unrolled at compile time for
+ * the 4x4 to 7x7 marker sizes.
+ *
+ * identify() returns the same id and rotation as
+ * cv::aruco::Dictionary::identify(): the first marker whose closest
+ * rotation is within the allowed number of erroneous bits.
+ */
+class MarkerIdentifier
+{
+public:
+    explicit MarkerIdentifier(const cv::Ptr<cv::aruco::Dictionary>& dictionary);
+
+    /**
+     * only_bits is the markerSize x markerSize CV_8UC1 matrix of 0 and 1
+     * read from a candidate, without the black border.
+     */
+    bool identify(const cv::Mat& only_bits, int& id, int& rotation,
+                  double max_correction_rate) const;
+
+    /**
+     * Hamming distance of the bits to the closest rotation of a marker.
+     */
+    int distance(const cv::Mat& only_bits, int id) const;
+
+    int markerSize() const { return marker_size_; }
+    int size() const { return static_cast<int>(codes_.size() / 4); }
+
+    // Codeword of a marker in one of its four rotations.
+    uint64_t codeword(int id, int rotation) const
+    {
+        return codes_[4 * id + rotation];
+    }
+
+    // Packs a bit matrix row by row, the first bit ending up highest.
+    static uint64_t pack(const cv::Mat& only_bits);
+
+private:
+    int marker_size_;
+    int max_correction_bits_;
+    std::vector<uint64_t> codes_;   // four rotations per marker
+    std::unordered_map<uint64_t, int> exact_;   // codeword -> 4 * id + rotation
+};
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_IDENTIFICATION_HPP
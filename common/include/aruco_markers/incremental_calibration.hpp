@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_INCREMENTAL_CALIBRATION_HPP
+#define ARUCO_MARKERS_INCREMENTAL_CALIBRATION_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/aruco.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "aruco_markers/frame_selection.hpp"
+
+
+namespace aruco_markers {
+
+/**
+ * Result of one calibration run over the views captured so far.
+ */
+struct CalibrationEstimate
+{
+    CalibrationEstimate() : views(0), error(0.0), converged(false) {}
+
+    int views;
+    double error;           // RMS reprojection error in pixels
+    cv::Mat camera_matrix;
+    cv::Mat dist_coeffs;
+    cv::Mat std_deviations; // fx, fy, cx, cy, k1, k2, p1, p2, k3, ...
+    bool converged;
+};
+
+/**
+ * Calibrates a camera in the background while views are being captured.
+ *
+ * Every added view wakes a worker thread that recalibrates over all views
+ * with cv::aruco::calibrateCameraAruco(), starting from the previous
+ * intrinsics (CALIB_USE_INTRINSIC_GUESS) so each run needs only a few
+ * iterations. Views that arrive during a run are picked up by the next one.
+ *
+ * The estimate counts as converged once, for several runs in a row, the
+ * standard deviation of fx, fy, cx and cy and the change of fx and fy
+ * since the previous run all stay below a fraction of the focal length.
+ */
+class IncrementalCalibrator
+{
+public:
+    /**
+     * camera_matrix seeds the first run, e.g. with the aspect ratio for
+     * CALIB_FIX_ASPECT_RATIO; it may be empty.
+     */
+    IncrementalCalibrator(const cv::Ptr<cv::aruco::Board>& board,
+                          cv::Size image_size, int flags,
+                          const cv::Mat& camera_matrix = cv::Mat());
+    ~IncrementalCalibrator();
+
+    /**
+     * tolerance: fraction of the focal length, default 0.005.
+     * min_views: views before the first run, default 5.
+     * stable_runs: consecutive runs within tolerance, default 3.
+     */
+    void setConvergence(double tolerance, int min_views, int stable_runs);
+
+    // Queues a view and returns immediately.
+    void addView(const CalibrationView& view);
+
+    // Latest estimate; false before the first run finished.
+    bool estimate(CalibrationEstimate& estimate) const;
+
+    /**
+     * Why the latest run failed, e.g. degenerate views; empty when it
+     * succeeded or none ran yet.
+     */
+    std::string failure() const;
+
+    /**
+     * Waits for a run over every added view, stops the worker and returns
+     * the final estimate; false when there were too few views or the run
+     * over all of them failed, see failure(). The estimate of an earlier
+     * run is then left out, it does not cover every view.
+     */
+    bool finish(CalibrationEstimate& estimate);
+
+private:
+    IncrementalCalibrator(const IncrementalCalibrator&);
+    IncrementalCalibrator& operator=(const IncrementalCalibrator&);
+
+    void run();
+    bool calibrate(const std::vector<CalibrationView>& views,
+                   CalibrationEstimate& result, std::string& failure) const;
+
+    cv::Ptr<cv::aruco::Board> board_;
+    cv::Size image_size_;
+    int flags_;
+    double tolerance_;
+    int min_views_;
+    int stable_runs_;
+
+    std::vector<CalibrationView> views_;
+    CalibrationEstimate estimate_;
+    bool has_estimate_;
+    int stable_;
+    size_t solving_;       // views in the run in progress
+    size_t solved_;        // views in the latest finished run
+    std::string failure_;  // of the latest finished run
+    bool stopping_;
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    std::thread worker_;
+};
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_INCREMENTAL_CALIBRATION_HPP
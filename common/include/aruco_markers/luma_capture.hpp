@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_LUMA_CAPTURE_HPP
+#define ARUCO_MARKERS_LUMA_CAPTURE_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+
+namespace aruco_markers {
+
+/**
+ * Retrieves only the luma (Y) plane of an opened capture.
+ *
+ * Detection works on one channel, so decoding to BGR and converting back
+ * to gray wastes two thirds of the retrieve bandwidth. configure() asks a
+ * camera for GREY, YUYV or NV12 frames without the RGB conversion of the
+ * backend, and retrieve() then takes the Y plane out of the raw buffer
+ * with a single one-channel copy. Sources that refuse, such as files and
+ * MJPEG cameras, keep delivering BGR and are converted to gray instead, so
+ * the output is always an 8-bit single-channel image.
+ *
+ * Frames are retrieved into a buffer owned by the capture, so one
+ * LumaCapture must only be used from one thread.
+ */
+class LumaCapture
+{
+public:
+    enum Format
+    {
+        BGR,
+        GREY,
+        YUYV,
+        NV12
+    };
+
+    explicit LumaCapture(cv::VideoCapture& capture);
+
+    /**
+     * Requests a luma format from the capture, which must be open, and
+     * returns the format that frames will arrive in.
+     */
+    Format configure();
+    Format format() const { return format_; }
+
+    /**
+     * Retrieves the grabbed frame as a CV_8UC1 image, in place when luma
+     * already has the frame size. A raw frame smaller than the size the
+     * capture reported is reported on stderr and returns false.
+     */
+    bool retrieve(cv::Mat& luma);
+
+    static const char* formatName(Format format);
+
+private:
+    LumaCapture(const LumaCapture&);
+    LumaCapture& operator=(const LumaCapture&);
+
+    bool requestRaw(int fourcc, Format format);
+
+    cv::VideoCapture& capture_;
+    Format format_;
+    cv::Size size_;
+    cv::Mat raw_;
+};
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_LUMA_CAPTURE_HPP
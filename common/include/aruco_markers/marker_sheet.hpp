@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_MARKER_SHEET_HPP
+#define ARUCO_MARKERS_MARKER_SHEET_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/aruco.hpp>
+#include <string>
+#include <vector>
+
+
+namespace aruco_markers {
+
+/**
+ * Page geometry of printed marker sheets, all lengths in millimetres.
+ * Defaults to A4 portrait with 40 mm markers.
+ */
+struct SheetLayout
+{
+    double page_width;
+    double page_height;
+    double margin;          // blank border of the page
+    double marker_length;   // side of a marker including its black border
+    double gap;             // white space between markers
+    int border_bits;
+    bool labels;            // print the id below every marker
+
+    SheetLayout()
+        : page_width(210), page_height(297), margin(10), marker_length(40),
+          gap(10), border_bits(1), labels(true)
+    {
+    }
+};
+
+/**
+ * Lays out markers of a dictionary on pages and renders them as SVG, PDF
+ * or raster images.
+ *
+ * The bit pattern of every marker is unpacked once, when the sheets are
+ * built, into the horizontal runs of black cells it is drawn with, so a
+ * marker costs a handful of rectangles on any output. Pages fill row by
+ * row from the top left in the order the ids are given; the writers
+ * render pages in parallel.
+ */
+class MarkerSheets
+{
+public:
+    MarkerSheets(const cv::Ptr<cv::aruco::Dictionary>& dictionary,
+                 const std::vector<int>& ids,
+                 const SheetLayout& layout = SheetLayout());
+
+    int pages() const { return pages_; }
+    int columns() const { return columns_; }
+    int rows() const { return rows_; }
+    int markersPerPage() const { return columns_ * rows_; }
+    const SheetLayout& layout() const { return layout_; }
+
+    /**
+     * Top left corner of the index-th marker on its page, in millimetres.
+     */
+    cv::Point2d position(size_t index) const;
+
+    std::string svg(int page) const;
+
+    /**
+     * The page as a white CV_8UC1 image at the given resolution.
+     */
+    cv::Mat raster(int page, double dpi) const;
+
+    /**
+     * Write one file per page, numbered through pageFileName(). Return
+     * false if a page could not be written.
+     */
+    bool writeSvg(const std::string& filename) const;
+    bool writeRaster(const std::string& filename, double dpi) const;
+
+    /**
+     * Writes all pages to one PDF document.
+     */
+    bool writePdf(const std::string& filename) const;
+
+    /**
+     * Inserts the page number before the extension of filename, e.g.
+     * sheet.svg -> sheet_001.svg. A single page keeps the name.
+     */
+    std::string pageFileName(const std::string& filename, int page) const;
+
+private:
+    // black cells of a marker row, in cells from the marker's top left
+    struct Run
+    {
+        int row;
+        int start;
+        int length;
+    };
+
+    void pageRange(int page, size_t& first, size_t& last) const;
+    std::string pdfContent(int page) const;
+
+    SheetLayout layout_;
+    std::vector<int> ids_;
+    std::vector<std::vector<Run> > runs_;
+    int cells_;
+    int columns_;
+    int rows_;
+    int pages_;
+
+    MarkerSheets(const MarkerSheets&);
+    MarkerSheets& operator=(const MarkerSheets&);
+};
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_MARKER_SHEET_HPP
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_MULTI_PIPELINE_HPP
+#define ARUCO_MARKERS_MULTI_PIPELINE_HPP
+
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "aruco_markers/frame_pool.hpp"
+#include "aruco_markers/pipeline.hpp"
+#include "aruco_markers/reorder_buffer.hpp"
+#include "aruco_markers/thread_pool.hpp"
+
+
+namespace aruco_markers {
+
+/**
+ * Several cameras in one process: capture per camera, detection and pose
+ * on one shared pool, output aligned by capture time.
+ *
+ * Every camera has its own capture thread and frame pool. Each captured
+ * frame runs detection and pose as one task on a work-stealing
+ * ThreadPool shared by all cameras, and a reorder buffer per camera puts
+ * the results back into capture order. Each camera may have only a few
+ * frames in flight, so a camera that falls behind cannot crowd out the
+ * others on the pool.
+ *
+ * The output stage, on the thread that calls run(), receives one frame
+ * per camera whose capture times lie within the sync tolerance of each
+ * other. A frame too old to match the other cameras' is dropped and
+ * counted. Timestamps of all cameras are on the clock of elapsed(),
+ * unless the cameras come with a clock of their own, such as the time of
+ * a frame within its file, which makes the sets of recordings repeatable.
+ *
+ * Detection and pose stages are called concurrently, for the same camera
+ * too, and are told which camera a frame comes from.
+ */
+class MultiCameraPipeline
+{
+public:
+    typedef Pipeline::CaptureStage CaptureStage;
+    typedef std::function<void(size_t, Frame&)> ProcessStage;
+    // Consumes one frame per camera and returns false to stop.
+    typedef std::function<bool(std::vector<Frame>&)> OutputStage;
+    // Capture time in seconds of the frame with the given index.
+    typedef std::function<double(int64_t)> ClockStage;
+
+    // workers == 0 uses one thread per core
+    explicit MultiCameraPipeline(size_t workers = 0);
+    ~MultiCameraPipeline();
+
+    /**
+     * Returns the number of the new camera, counting from 0. Without a
+     * clock, frames are stamped with elapsed() when they are captured.
+     */
+    size_t addCamera(const CaptureStage& capture,
+                     const ClockStage& clock = ClockStage());
+    size_t cameras() const { return cameras_.size(); }
+
+    void setDetection(const ProcessStage& stage);
+    void setPose(const ProcessStage& stage);
+    void setOutput(const OutputStage& stage);
+
+    /**
+     * Largest difference of capture times within one output set, in
+     * seconds. Default 0.02, below the frame period of 30 fps cameras.
+     */
+    void setSyncTolerance(double seconds);
+
+    /**
+     * Runs until any camera is exhausted or the output stage asks to
+     * stop. A pipeline can be run only once.
+     */
+    void run();
+    void stop();
+
+    double elapsed() const;
+
+    // Frames of a camera dropped because no other camera matched them.
+    uint64_t dropped(size_t camera) const;
+
+private:
+    MultiCameraPipeline(const MultiCameraPipeline&);
+    MultiCameraPipeline& operator=(const MultiCameraPipeline&);
+
+    struct Camera
+    {
+        Camera() : frame_type(0), dropped(0) {}
+
+        CaptureStage capture;
+        ClockStage clock;
+        FramePool frames;
+        std::unique_ptr<ReorderBuffer<Frame> > ordered;
+        cv::Size frame_size;
+        int frame_type;
+        std::atomic<uint64_t> dropped;
+    };
+
+    void captureLoop(size_t camera);
+    void processFrame(size_t camera, const std::shared_ptr<Frame>& frame);
+    bool nextSet(std::vector<Frame>& frames);
+    void fail(std::exception_ptr error);
+
+    std::vector<std::unique_ptr<Camera> > cameras_;
+    ProcessStage detection_;
+    ProcessStage pose_;
+    OutputStage output_;
+    double tolerance_;
+    size_t workers_;
+    size_t window_;
+    std::unique_ptr<ThreadPool> pool_;
+
+    std::atomic<bool> stopped_;
+    std::chrono::steady_clock::time_point start_;
+    std::exception_ptr error_;
+    std::mutex error_mutex_;
+};
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_MULTI_PIPELINE_HPP
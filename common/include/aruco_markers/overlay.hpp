@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_OVERLAY_HPP
+#define ARUCO_MARKERS_OVERLAY_HPP
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+#include "aruco_markers/roi_tracker.hpp"
+
+
+namespace aruco_markers {
+
+/**
+ * Draws detected markers with their pose, as axes or as a cube standing
+ * on each marker, and the position of the first marker as text.
+ *
+ * The vertices of all markers are moved into the camera frame and
+ * projected with a single cv::projectPoints() call, and all edges of one
+ * colour are drawn with a single cv::polylines() call. The buffers are
+ * kept between frames, so an overlay should be used by one thread only.
+ * Markers with a vertex behind the camera are left out.
+ */
+class PoseOverlay
+{
+public:
+    enum Shape
+    {
+        AXES,   // as cv::aruco::drawAxis()
+        CUBE    // wireframe cube with the marker's side length
+    };
+
+    PoseOverlay(Shape shape, float marker_length,
+                const cv::Mat& camera_matrix, const cv::Mat& dist_coeffs);
+
+    // Length of the drawn axes in meter, default 0.1.
+    void setAxisLength(float length);
+
+    void draw(cv::Mat& image, const MarkerCorners& corners,
+              const std::vector<int>& ids,
+              const std::vector<cv::Vec3d>& rvecs,
+              const std::vector<cv::Vec3d>& tvecs);
+
+private:
+    PoseOverlay(const PoseOverlay&);
+    PoseOverlay& operator=(const PoseOverlay&);
+
+    void setModel();
+
+    Shape shape_;
+    float marker_length_;
+    float axis_length_;
+    cv::Mat camera_matrix_;
+    cv::Mat dist_coeffs_;
+    std::vector<cv::Point3f> model_;
+
+    std::vector<cv::Point3f> camera_points_;
+    std::vector<cv::Point2f> image_points_;
+    std::vector<char> visible_;
+    std::vector<std::vector<cv::Point> > closed_;
+    std::vector<std::vector<cv::Point> > open_[3];   // per colour
+};
+
+/**
+ * Copies a frame into the buffer an overlay is drawn on, expanding gray
+ * frames to BGR so the overlay keeps its colours. image and canvas may be
+ * the same.
+ */
+void copyToCanvas(const cv::Mat& image, cv::Mat& canvas);
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_OVERLAY_HPP
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef ARUCO_MARKERS_PIPELINE_HPP
+#define ARUCO_MARKERS_PIPELINE_HPP
+
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "aruco_markers/bounded_queue.hpp"
+#include "aruco_markers/frame_pool.hpp"
+#include "aruco_markers/reorder_buffer.hpp"
+#include "aruco_markers/thread_pool.hpp"
+
+
+namespace aruco_markers {
+
+/**
+ * A captured image together with everything the later stages attach to it.
+ */
+struct Frame
+{
+    Frame() : index(0), timestamp(0.0) {}
+
+    int64_t index;      // position in the capture stream, starting at 0
+    double timestamp;   // seconds since the pipeline started, at capture
+    cv::Mat image;
+    std::vector<int> ids;
+    std::vector<std::vector<cv::Point2f> > corners;
+    std::vector<cv::Vec3d> rvecs, tvecs;
+    // per marker, set for poses a PoseFilter predicted instead of
+    // measuring them; empty when every marker was detected
+    std::vector<bool> predicted;
+
+    bool isPredicted(size_t marker) const
+    {
+        return marker < predicted.size() && predicted[marker];
+    }
+};
+
+// Marker flag of binary result logs and pose messages, see isPredicted().
+const uint32_t kMarkerPredicted = 1;
+
+/**
+ * Capture -> detection -> pose -> output, each stage on its own thread.
+ *
+ * Stages are joined by bounded queues, so while frame N is being detected
+ * frame N+1 is already decoding and frame N-1 is being drawn. Throughput is
+ * bounded by the slowest stage instead of the sum of all of them.
+ *
+ * Captured images are drawn from a FramePool sized for every frame that can
+ * be in flight, so a capture stage that retrieves into the image it is
+ * given reuses the same few buffers instead of allocating each frame.
+ *
+ * The output stage runs on the thread that calls run(), which keeps
+ * cv::imshow()/cv::waitKey() on the main thread as HighGUI requires.
+ * Detection and pose stages are optional; a missing stage passes frames
+ * through untouched. An exception thrown by any stage stops the pipeline
+ * and is rethrown from run().
+ *
+ * With more than one worker (setWorkers) frames are instead processed in
+ * parallel: each captured frame runs detection and pose as one task on a
+ * work-stealing thread pool, and a reorder buffer hands the results to the
+ * output stage in capture order. This suits independent frames such as a
+ * recorded file; detection and pose stages must then be safe to call
+ * concurrently and must not depend on the previous frame.
+ */
+class Pipeline
+{
+public:
+    // Fills the image and returns false once the source is exhausted.
+    typedef std::function<bool(cv::Mat&)> CaptureStage;
+    typedef std::function<void(Frame&)> ProcessStage;
+    // Consumes a finished frame and returns false to stop the pipeline.
+    typedef std::function<bool(Frame&)> OutputStage;
+
+    explicit Pipeline(size_t queue_capacity = 2);
+    ~Pipeline();
+
+    void setCapture(const CaptureStage& stage);
+    void setDetection(const ProcessStage& stage);
+    void setPose(const ProcessStage& stage);
+    void setOutput(const OutputStage& stage);
+
+    /**
+     * Number of threads running detection and pose; 0 uses all cores.
+     * The default of 1 keeps the one-thread-per-stage layout.
+     */
+    void setWorkers(size_t workers);
+
+    /**
+     * Runs until the capture stage is exhausted or the output stage asks to
+     * stop. A pipeline can be run only once.
+     */
+    void run();
+
+    /**
+     * Asks all stages to finish; frames still queued are dropped.
+     */
+    void stop();
+
+    /**
+     * Seconds since run() started, on the same clock as Frame::timestamp.
+     */
+    double elapsed() const;
+
+private:
+    Pipeline(const Pipeline&);
+    Pipeline& operator=(const Pipeline&);
+
+    void captureLoop();
+    void processLoop(const ProcessStage& stage, BoundedQueue<Frame>& input,
+                     BoundedQueue<Frame>& output);
+    void dispatchLoop();
+    void processFrame(const std::shared_ptr<Frame>& frame);
+    bool nextOutput(Frame& frame);
+    bool captureFrame(Frame& frame, int64_t index);
+    void fail(std::exception_ptr error);
+
+    CaptureStage capture_;
+    ProcessStage detection_;
+    ProcessStage pose_;
+    OutputStage output_;
+
+    BoundedQueue<Frame> captured_;
+    BoundedQueue<Frame> detected_;
+    BoundedQueue<Frame> posed_;
+
+    size_t queue_capacity_;
+    size_t workers_;
+    FramePool frames_;
+    cv::Size frame_size_;
+    int frame_type_;
+    std::unique_ptr<ReorderBuffer<Frame> > reordered_;
+    std::unique_ptr<ThreadPool> pool_;   // after reordered_, joins first
+
+    std::atomic<bool> stopped_;
+    std::chrono::steady_clock::time_point start_;
+    std::exception_ptr error_;
+    std::mutex error_mutex_;
+};
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_PIPELINE_HPP
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_POSE_HPP
+#define ARUCO_MARKERS_POSE_HPP
+
+#include <opencv2/core.hpp>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "aruco_markers/roi_tracker.hpp"
+
+
+namespace aruco_markers {
+
+/**
+ * Both solutions of a planar square pose, the chosen one first.
+ *
+ * A square seen from far away or nearly head-on has two poses that
+ * reproject almost equally well, mirrored about the line of sight.
+ * Errors are RMS reprojection errors in pixels.
+ */
+struct MarkerPose
+{
+    cv::Vec3d rvec, tvec;
+    double error;
+    cv::Vec3d alt_rvec, alt_tvec;
+    double alt_error;
+};
+
+/**
+ * Image corners of a marker at the given pose, in the corner order of
+ * cv::aruco::detectMarkers().
+ */
+std::vector<cv::Point2f> projectMarkerCorners(float marker_length,
+                                              const cv::Mat& camera_matrix,
+                                              const cv::Mat& dist_coeffs,
+                                              const cv::Vec3d& rvec,
+                                              const cv::Vec3d& tvec);
+
+/**
+ * Pose of every marker of a frame at once.
+ *
+ * The corners of all markers are undistorted in one cv::undistortPoints()
+ * call and each marker is then solved in normalized coordinates with the
+ * closed-form IPPE square solver, which also returns the second, mirrored
+ * solution. Markers are solved in parallel when there are many of them.
+ * Object points follow cv::aruco::estimatePoseSingleMarkers(), so poses
+ * can be drawn and logged the same way.
+ *
+ * With warm start, a marker whose two solutions are ambiguous keeps the
+ * one closer to its pose in the previous frame instead of flipping
+ * between them; frames must then be solved in capture order.
+ */
+class SquarePoseSolver
+{
+public:
+    SquarePoseSolver(float marker_length, const cv::Mat& camera_matrix,
+                     const cv::Mat& dist_coeffs);
+
+    void setWarmStart(bool enabled);
+
+    /**
+     * Two solutions count as ambiguous when the alternative reprojects
+     * within this factor of the best one. Default 2.
+     */
+    void setAmbiguityRatio(double ratio);
+
+    void solve(const MarkerCorners& corners, const std::vector<int>& ids,
+               std::vector<cv::Vec3d>& rvecs, std::vector<cv::Vec3d>& tvecs,
+               std::vector<MarkerPose>* poses = nullptr);
+
+    // Forgets the poses of the previous frame.
+    void reset();
+
+private:
+    SquarePoseSolver(const SquarePoseSolver&);
+    SquarePoseSolver& operator=(const SquarePoseSolver&);
+
+    void solveMarker(const cv::Point2f* normalized, MarkerPose& pose) const;
+
+    std::vector<cv::Point3f> object_points_;
+    cv::Mat camera_matrix_;
+    cv::Mat dist_coeffs_;
+    double focal_;
+    bool warm_start_;
+    double ambiguity_ratio_;
+    std::map<int, cv::Vec3d> previous_;   // id -> rvec of the last frame
+    std::mutex previous_mutex_;
+};
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_POSE_HPP
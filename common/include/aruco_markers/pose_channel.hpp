@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_POSE_CHANNEL_HPP
+#define ARUCO_MARKERS_POSE_CHANNEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "aruco_markers/pipeline.hpp"
+
+
+namespace aruco_markers {
+
+const uint32_t kMaxPoseMarkers = 64;
+
+struct PoseRecord
+{
+    int32_t id;
+    uint32_t flags;     // kMarkerPredicted for a predicted pose
+    double rvec[3];
+    double tvec[3];
+};
+
+/**
+ * Poses of one frame as published to local consumers. Plain data, copied
+ * as is into shared memory and datagrams; only the first count markers
+ * are valid, frames with more markers are cut at kMaxPoseMarkers.
+ */
+struct PoseMessage
+{
+    int64_t frame;
+    double timestamp;        // seconds since the publisher started
+    uint64_t publish_ns;     // monotonic clock when published
+    uint64_t sequence;       // counts the messages of one publisher
+    uint32_t camera;
+    uint32_t count;
+    PoseRecord markers[kMaxPoseMarkers];
+
+    // Bytes up to and including the last valid marker.
+    size_t usedSize() const;
+};
+
+/**
+ * Fills a message from a frame with poses.
+ */
+void toPoseMessage(const Frame& frame, uint32_t camera,
+                   PoseMessage& message);
+
+/**
+ * Monotonic clock in nanoseconds, comparable between processes on the
+ * same machine.
+ */
+uint64_t monotonicNanoseconds();
+
+// Shared memory layout of the ring, defined with the channel.
+struct PoseRing;
+
+/**
+ * Publishes pose messages to a POSIX shared memory ring.
+ *
+ * The segment holds a fixed ring of message slots, each guarded by a
+ * sequence counter that is odd while the slot is written. The publisher
+ * never waits for readers: it overwrites the oldest slot, and a reader
+ * that falls a full ring behind skips ahead and counts what it lost. Any
+ * number of readers can follow one publisher without locks and without
+ * the publisher knowing about them.
+ *
+ * The segment is created on open() and unlinked when the publisher
+ * closes. Not available on Windows, where open() returns false.
+ */
+class PosePublisher
+{
+public:
+    PosePublisher();
+    ~PosePublisher();
+
+    /**
+     * Creates the ring; name is a shared memory object name such as
+     * "/aruco_poses". Fails with errno EEXIST when the name is taken,
+     * possibly by a publisher that is still running. With replace an
+     * existing segment is unlinked first, e.g. one left behind by a
+     * publisher that crashed; its readers are then orphaned.
+     */
+    bool open(const std::string& name, bool replace = false,
+              uint32_t slots = 256);
+    void close();
+    bool isOpened() const { return ring_ != nullptr; }
+
+    void publish(const PoseMessage& message);
+
+private:
+    PosePublisher(const PosePublisher&);
+    PosePublisher& operator=(const PosePublisher&);
+
+    PoseRing* ring_;
+    size_t size_;
+    std::string name_;
+};
+
+/**
+ * Follows the ring of a PosePublisher, see there.
+ */
+class PoseSubscriber
+{
+public:
+    PoseSubscriber();
+    ~PoseSubscriber();
+
+    /**
+     * Attaches to the ring and starts at its next message. Returns false
+     * while no publisher has created it.
+     */
+    bool open(const std::string& name);
+    void close();
+    bool isOpened() const { return ring_ != nullptr; }
+
+    /**
+     * Copies the next message published since the last one read. Returns
+     * false if there is none yet.
+     */
+    bool read(PoseMessage& message);
+
+    /**
+     * Waits up to timeout seconds for the next message, spinning for the
+     * first microseconds so a waiting reader picks a message up right
+     * after it is published.
+     */
+    bool wait(PoseMessage& message, double timeout);
+
+    // Messages overwritten before this subscriber could read them.
+    uint64_t lost() const { return lost_; }
+
+private:
+    PoseSubscriber(const PoseSubscriber&);
+    PoseSubscriber& operator=(const PoseSubscriber&);
+
+    PoseRing* ring_;
+    size_t size_;
+    uint64_t next_;
+    uint64_t lost_;
+};
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_POSE_CHANNEL_HPP
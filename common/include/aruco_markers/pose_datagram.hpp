@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_POSE_DATAGRAM_HPP
+#define ARUCO_MARKERS_POSE_DATAGRAM_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "aruco_markers/pose_channel.hpp"
+
+
+namespace aruco_markers {
+
+/**
+ * Sends pose messages as UDP datagrams, one per frame, for consumers that
+ * cannot share memory with the publisher, e.g. in another container. A
+ * datagram holds the PoseMessage fields up to the last valid marker in
+ * host byte order, so both ends must run on the same architecture.
+ *
+ * Sending never blocks on the consumer; datagrams nobody receives are
+ * dropped by the network stack. Not available on Windows.
+ */
+class PoseDatagramPublisher
+{
+public:
+    PoseDatagramPublisher();
+    ~PoseDatagramPublisher();
+
+    // address is host:port, e.g. 127.0.0.1:5005
+    bool open(const std::string& address);
+    void close();
+    bool isOpened() const { return socket_ >= 0; }
+
+    void publish(const PoseMessage& message);
+
+private:
+    PoseDatagramPublisher(const PoseDatagramPublisher&);
+    PoseDatagramPublisher& operator=(const PoseDatagramPublisher&);
+
+    int socket_;
+    uint64_t sequence_;
+};
+
+/**
+ * Receives the datagrams of a PoseDatagramPublisher and counts the ones
+ * lost on the way from gaps in their sequence numbers.
+ */
+class PoseDatagramSubscriber
+{
+public:
+    PoseDatagramSubscriber();
+    ~PoseDatagramSubscriber();
+
+    // address is host:port to listen on, e.g. 127.0.0.1:5005
+    bool open(const std::string& address);
+    void close();
+    bool isOpened() const { return socket_ >= 0; }
+
+    /**
+     * Waits up to timeout seconds for the next message; datagrams that are
+     * not pose messages are skipped.
+     */
+    bool wait(PoseMessage& message, double timeout);
+
+    /**
+     * Datagrams missing between the ones received. A sequence number that
+     * goes back starts counting anew, as after a publisher restart.
+     */
+    uint64_t lost() const { return lost_; }
+
+private:
+    PoseDatagramSubscriber(const PoseDatagramSubscriber&);
+    PoseDatagramSubscriber& operator=(const PoseDatagramSubscriber&);
+
+    int socket_;
+    bool started_;
+    uint64_t next_;
+    uint64_t lost_;
+};
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_POSE_DATAGRAM_HPP
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_POSE_FILTER_HPP
+#define ARUCO_MARKERS_POSE_FILTER_HPP
+
+#include <opencv2/core.hpp>
+#include <map>
+#include <vector>
+
+
+namespace aruco_markers {
+
+/**
+ * Constant-velocity alpha-beta filter over the poses of each marker id.
+ *
+ * Measured poses are blended with the pose predicted from the marker's
+ * last state: alpha weighs the measurement against the prediction, beta
+ * how fast the velocity follows. Rotation is filtered on the rotation
+ * group, its residual being the rotation vector from the predicted to
+ * the measured orientation.
+ *
+ * Markers that were tracked but are missing from a frame, because
+ * detection failed or was skipped, are appended with their predicted
+ * pose until they have not been measured for max_age seconds.
+ */
+class PoseFilter
+{
+public:
+    explicit PoseFilter(double alpha = 0.5, double beta = 0.1,
+                        double max_age = 0.5);
+
+    /**
+     * Replaces the measured poses by filtered ones and appends predicted
+     * markers. predicted, when given, tells which entries are predicted.
+     * Timestamps are in seconds and must not decrease.
+     */
+    void filter(double timestamp, std::vector<int>& ids,
+                std::vector<cv::Vec3d>& rvecs, std::vector<cv::Vec3d>& tvecs,
+                std::vector<bool>* predicted = nullptr);
+
+    void reset();
+
+private:
+    struct Track
+    {
+        double time;
+        cv::Vec3d position, velocity;
+        cv::Matx33d rotation;
+        cv::Vec3d angular_velocity;
+    };
+
+    static void predict(const Track& track, double dt, cv::Vec3d& position,
+                        cv::Matx33d& rotation);
+
+    double alpha_;
+    double beta_;
+    double max_age_;
+    std::map<int, Track> tracks_;
+};
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_POSE_FILTER_HPP
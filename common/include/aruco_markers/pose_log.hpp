@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_POSE_LOG_HPP
+#define ARUCO_MARKERS_POSE_LOG_HPP
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "aruco_markers/pipeline.hpp"
+
+
+namespace aruco_markers {
+
+/**
+ * One frame of a log and where its markers start.
+ */
+struct PoseLogEntry
+{
+    int64_t frame;
+    double timestamp;
+    uint64_t offset;
+};
+
+/**
+ * Random access to a binary result log written by BinaryResultWriter.
+ *
+ * The log and its frame index are memory mapped and records are decoded
+ * straight from the mapping, so seeking to a frame or time is a binary
+ * search over the index and reading a record touches only its bytes.
+ * Without a usable index, or past its end when the writer was cut short,
+ * the records are scanned once to build the index in memory. Opening
+ * checks every index entry against the record it points to and scans
+ * from the first that does not match, such as the entries of a stale
+ * index left by an earlier log of the same name. A trailing partial
+ * record is ignored.
+ *
+ * Frame indices and timestamps must not decrease along the log, as the
+ * runtime tools write them.
+ */
+class PoseLogReader
+{
+public:
+    PoseLogReader();
+    ~PoseLogReader();
+
+    /**
+     * Returns false if the file is missing or not a binary result log.
+     */
+    bool open(const std::string& path);
+    void close();
+
+    // Number of frames in the log.
+    size_t size() const { return count_; }
+
+    const PoseLogEntry& entry(size_t record) const { return entries_[record]; }
+
+    // Whether the .idx file was used, at least for part of the log.
+    bool indexed() const { return indexed_; }
+
+    /**
+     * First record at or after the frame index or time, size() if none.
+     */
+    size_t seekFrame(int64_t frame) const;
+    size_t seekTime(double seconds) const;
+
+    void read(size_t record, Frame& frame) const;
+
+    /**
+     * Pose of one marker in a record. Returns false if the marker is not
+     * in the frame or the log has no poses for it.
+     */
+    bool findPose(size_t record, int id, cv::Vec3d& rvec,
+                  cv::Vec3d& tvec) const;
+
+    // Ids seen anywhere in the log, sorted.
+    std::vector<int> ids() const;
+
+private:
+    PoseLogReader(const PoseLogReader&);
+    PoseLogReader& operator=(const PoseLogReader&);
+
+    class MappedFile;
+
+    void scan(uint64_t offset);
+    const unsigned char* record(size_t index, uint32_t& count,
+                                bool& has_pose) const;
+
+    std::unique_ptr<MappedFile> log_;
+    std::unique_ptr<MappedFile> index_;
+    uint32_t version_;
+    std::vector<PoseLogEntry> scanned_;   // entries not found in the index
+    const PoseLogEntry* entries_;
+    size_t count_;
+    bool indexed_;
+};
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_POSE_LOG_HPP
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_POSE_OUTPUT_HPP
+#define ARUCO_MARKERS_POSE_OUTPUT_HPP
+
+#include <cstdint>
+#include <string>
+
+#include <opencv2/core/utility.hpp>
+
+#include "aruco_markers/pipeline.hpp"
+#include "aruco_markers/pose_channel.hpp"
+#include "aruco_markers/pose_datagram.hpp"
+
+
+namespace aruco_markers {
+
+/**
+ * The pose publishers of a tool: a shared memory ring for readers on the
+ * same machine and UDP datagrams for the others, either or both.
+ */
+class PoseOutput
+{
+public:
+    PoseOutput();
+
+    /**
+     * Opens the ring named shm_name and the datagram destination
+     * udp_address (host:port); an empty name or address leaves that
+     * publisher closed. replace takes over a ring of the same name, see
+     * PosePublisher::open(). Returns false with a message in error when a
+     * requested publisher cannot be opened.
+     */
+    bool open(const std::string& shm_name, const std::string& udp_address,
+              bool replace, std::string& error);
+
+    bool isOpened() const
+    {
+        return shared_.isOpened() || datagrams_.isOpened();
+    }
+
+    /**
+     * Publishes the poses of a frame; does nothing when no publisher is
+     * open. Not thread-safe, call it from the output stage.
+     */
+    void publish(const Frame& frame, uint32_t camera = 0);
+
+private:
+    PoseOutput(const PoseOutput&);
+    PoseOutput& operator=(const PoseOutput&);
+
+    PosePublisher shared_;
+    PoseDatagramPublisher datagrams_;
+    PoseMessage message_;
+};
+
+/**
+ * Opens output from the shm, udp and shmforce keys of a tool's command
+ * line, printing the reason to stderr when a publisher cannot be opened.
+ */
+bool openPoseOutput(const cv::CommandLineParser& parser, PoseOutput& output);
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_POSE_OUTPUT_HPP
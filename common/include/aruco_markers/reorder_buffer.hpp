@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef ARUCO_MARKERS_REORDER_BUFFER_HPP
+#define ARUCO_MARKERS_REORDER_BUFFER_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <utility>
+
+
+namespace aruco_markers {
+
+/**
+ * Collects items completed out of order and hands them out in sequence.
+ *
+ * Items are numbered 0, 1, 2, ... by the producer. At most `window` items
+ * may be in flight past the next one to be popped: waitForSlot() blocks the
+ * producer until its item fits, which bounds memory however far the
+ * slowest item lags behind. push() never blocks, so workers cannot
+ * deadlock on it.
+ */
+template <typename T>
+class ReorderBuffer
+{
+public:
+    explicit ReorderBuffer(size_t window)
+        : window_(window > 0 ? window : 1),
+          next_(0),
+          end_(std::numeric_limits<int64_t>::max()),
+          cancelled_(false)
+    {
+    }
+
+    bool waitForSlot(int64_t index)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_.wait(lock, [this, index] {
+            return cancelled_ ||
+                   index < next_ + static_cast<int64_t>(window_);
+        });
+        return !cancelled_;
+    }
+
+    void push(int64_t index, T item)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (cancelled_)
+            return;
+        items_.insert(std::make_pair(index, std::move(item)));
+        if (index == next_)
+            ready_.notify_all();
+    }
+
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [this] {
+            return cancelled_ || next_ >= end_ ||
+                   (!items_.empty() && items_.begin()->first == next_);
+        });
+        if (cancelled_ || next_ >= end_)
+            return false;
+        item = std::move(items_.begin()->second);
+        items_.erase(items_.begin());
+        next_++;
+        space_.notify_all();
+        return true;
+    }
+
+    // No item with an index at or past `end` will be pushed.
+    void finish(int64_t end)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        end_ = end;
+        ready_.notify_all();
+    }
+
+    void cancel()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+        items_.clear();
+        ready_.notify_all();
+        space_.notify_all();
+    }
+
+private:
+    ReorderBuffer(const ReorderBuffer&);
+    ReorderBuffer& operator=(const ReorderBuffer&);
+
+    const size_t window_;
+    int64_t next_;
+    int64_t end_;
+    bool cancelled_;
+    std::map<int64_t, T> items_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::condition_variable space_;
+};
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_REORDER_BUFFER_HPP
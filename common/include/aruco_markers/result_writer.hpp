@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef ARUCO_MARKERS_RESULT_WRITER_HPP
+#define ARUCO_MARKERS_RESULT_WRITER_HPP
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "aruco_markers/pipeline.hpp"
+
+
+namespace aruco_markers {
+
+/**
+ * Binary result stream layout (host byte order, little-endian on every
+ * platform we ship):
+ *
+ *   header:  char magic[8] = "ARUCOLOG", uint32 version, uint32 reserved
+ *   record:  uint32 size         bytes following this field
+ *            int64  frame index
+ *            float64 timestamp   seconds since start
+ *            uint32 marker count
+ *            uint32 has_pose     1 when rvec/tvec follow each marker
+ *            per marker:
+ *              int32   id
+ *              uint32  flags        1 when the marker was predicted, not
+ *                                   detected; version 2 and later
+ *              float32 corners[8]   x0 y0 x1 y1 x2 y2 x3 y3
+ *              float64 rvec[3], tvec[3]   only when has_pose
+ *
+ * Written to a file, the log gets a frame index next to it, <path>.idx:
+ *
+ *   header:  char magic[8] = "ARUCOIDX", uint32 version, uint32 reserved
+ *   entry:   int64   frame index
+ *            float64 timestamp
+ *            uint64  offset of the record's size field in the log
+ *
+ * Entries are 24 bytes and follow the 16 byte header, so a mapped index
+ * is an aligned array. Both files are only ever appended to; an index
+ * cut short by a crash is completed by PoseLogReader from the log.
+ */
+const char kBinaryMagic[8] = { 'A', 'R', 'U', 'C', 'O', 'L', 'O', 'G' };
+const uint32_t kBinaryVersion = 2;
+const char kIndexMagic[8] = { 'A', 'R', 'U', 'C', 'O', 'I', 'D', 'X' };
+const uint32_t kIndexVersion = 1;
+
+/**
+ * Serializes per-frame detection and pose results for offline consumers.
+ */
+class ResultWriter
+{
+public:
+    virtual ~ResultWriter();
+
+    virtual void write(const Frame& frame) = 0;
+    virtual void flush();
+
+    /**
+     * True after a write to the file failed or was cut short, which is
+     * also reported on stderr. Nothing is written after that.
+     */
+    bool failed() const { return failed_; }
+
+    /**
+     * Creates a writer for "jsonl" or "bin". An empty path or "-" writes to
+     * stdout. Returns an empty pointer for an unknown format or a file that
+     * cannot be opened.
+     */
+    static cv::Ptr<ResultWriter> create(const std::string& format,
+                                        const std::string& path);
+
+    // Name of the frame index written next to a binary log.
+    static std::string indexPath(const std::string& path);
+
+protected:
+    explicit ResultWriter(std::FILE* file);
+
+    // Writes size bytes or marks the writer failed; false once failed.
+    bool put(std::FILE* file, const void* data, size_t size);
+    void flushFile(std::FILE* file);
+    void fail();
+
+    std::FILE* file_;
+    bool failed_;
+
+private:
+    ResultWriter(const ResultWriter&);
+    ResultWriter& operator=(const ResultWriter&);
+};
+
+/**
+ * One JSON object per frame and line:
+ * {"frame":0,"t":0.033,"markers":[{"id":7,"corners":[[x,y],...],
+ *  "rvec":[...],"tvec":[...]}]}
+ * Predicted markers carry "predicted":true; their corners are projected
+ * from the predicted pose.
+ */
+class JsonlResultWriter : public ResultWriter
+{
+public:
+    explicit JsonlResultWriter(std::FILE* file);
+    void write(const Frame& frame);
+};
+
+/**
+ * Compact binary records in the layout documented at the top of this file,
+ * and an entry per record in the frame index when one is given.
+ */
+class BinaryResultWriter : public ResultWriter
+{
+public:
+    explicit BinaryResultWriter(std::FILE* file,
+                                std::FILE* index_file = nullptr);
+    ~BinaryResultWriter();
+    void write(const Frame& frame);
+    void flush();
+
+private:
+    std::string buffer_;
+    std::FILE* index_file_;
+    uint64_t offset_;   // where the next record starts
+};
+
+/**
+ * True when the path names the process' standard output.
+ */
+bool isStdoutPath(const std::string& path);
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_RESULT_WRITER_HPP
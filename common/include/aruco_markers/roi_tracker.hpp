@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef ARUCO_MARKERS_ROI_TRACKER_HPP
+#define ARUCO_MARKERS_ROI_TRACKER_HPP
+
+#include <opencv2/core.hpp>
+#include <functional>
+#include <vector>
+
+
+namespace aruco_markers {
+
+typedef std::vector<std::vector<cv::Point2f> > MarkerCorners;
+
+/**
+ * Detects markers in an image or image region, overwriting corners and ids
+ * with the result.
+ */
+typedef std::function<void(const cv::Mat& image, MarkerCorners& corners,
+                           std::vector<int>& ids)> DetectFunction;
+
+/**
+ * Restricts detection to padded regions around the markers found in the
+ * previous frame.
+ *
+ * Each marker's region is predicted from its last corners plus their
+ * frame-to-frame motion; overlapping regions are merged and the detector
+ * runs only inside them. The whole frame is scanned on the first frame,
+ * every rescan_interval frames, and immediately whenever a tracked marker
+ * is not found in its region, so new markers show up at the latest after
+ * rescan_interval frames while lost ones are recovered right away.
+ *
+ * The tracker is stateful and expects frames in capture order.
+ */
+class RoiTracker
+{
+public:
+    /**
+     * padding is the margin added around each predicted marker, relative to
+     * the marker's larger side.
+     */
+    RoiTracker(const DetectFunction& detect, int rescan_interval = 30,
+               float padding = 0.5f);
+
+    void detect(const cv::Mat& image, MarkerCorners& corners,
+                std::vector<int>& ids);
+
+    /**
+     * Whether the last call to detect() scanned the full frame.
+     */
+    bool lastWasFullScan() const { return full_scan_; }
+
+    void reset();
+
+private:
+    struct Track
+    {
+        int id;
+        std::vector<cv::Point2f> corners;
+        cv::Point2f velocity;
+    };
+
+    void detectFull(const cv::Mat& image, MarkerCorners& corners,
+                    std::vector<int>& ids);
+    bool detectInRegions(const cv::Mat& image, MarkerCorners& corners,
+                         std::vector<int>& ids);
+    void updateTracks(const MarkerCorners& corners,
+                      const std::vector<int>& ids);
+
+    DetectFunction detect_;
+    int rescan_interval_;
+    float padding_;
+    int frames_since_scan_;
+    bool full_scan_;
+    std::vector<Track> tracks_;
+
+    // scratch buffers reused across frames
+    std::vector<cv::Rect> regions_;
+    MarkerCorners region_corners_;
+    std::vector<int> region_ids_;
+};
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_ROI_TRACKER_HPP
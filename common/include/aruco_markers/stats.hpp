@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_STATS_HPP
+#define ARUCO_MARKERS_STATS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace aruco_markers {
+
+/**
+ * Latency histograms of named processing stages.
+ *
+ * Every thread records into its own set of histograms made of relaxed
+ * atomic counters, so recording never takes a lock and never contends with
+ * other threads; only the first record of a thread registers its set.
+ * Buckets are spaced four per octave from 1 us to a few minutes, which
+ * bounds percentile estimates to within 19%.
+ *
+ * A reporter thread started with startReporting() periodically merges the
+ * per-thread histograms into a Prometheus text file and a one-line summary.
+ * Recorded intervals can also be kept as Chrome trace events
+ * (chrome://tracing, Perfetto) until a fixed number of events is reached.
+ *
+ * Until enable() or enableTrace() is called StageTimer reads no clock and
+ * records nothing, so instrumented code costs one branch per stage.
+ */
+class Stats
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static const int kMaxStages = 16;
+    static const int kBuckets = 112;
+
+    Stats();
+    ~Stats();
+
+    /**
+     * Registers a stage and returns its id. Stages must be added before
+     * any thread records into them.
+     */
+    int addStage(const std::string& name);
+
+    void enable();
+    bool enableTrace(const std::string& path, size_t max_events = 100000);
+    bool enabled() const { return enabled_; }
+
+    void record(int stage, Clock::time_point start, Clock::time_point end);
+
+    /**
+     * Records a duration measured elsewhere, such as the latency from
+     * capture to pose. It is not added to the trace.
+     */
+    void record(int stage, double seconds);
+
+    /**
+     * Every interval seconds writes the Prometheus file, when a path is
+     * given, and a summary line to the stream, when one is given.
+     */
+    void startReporting(double interval, std::ostream* summary,
+                        const std::string& prometheus_path);
+
+    /**
+     * Stops the reporter after a final report and writes the trace.
+     */
+    void stopReporting();
+
+    std::string summary() const;
+    bool writePrometheus(const std::string& path) const;
+    bool writeTrace() const;
+
+private:
+    Stats(const Stats&);
+    Stats& operator=(const Stats&);
+
+    struct ThreadSlot
+    {
+        int tid;
+        std::atomic<uint64_t> counts[kMaxStages][kBuckets];
+        std::atomic<uint64_t> sum_ns[kMaxStages];
+    };
+
+    struct TraceEvent
+    {
+        int stage;
+        int tid;
+        int64_t start_us;
+        int64_t duration_us;
+    };
+
+    typedef std::array<uint64_t, kBuckets> Histogram;
+
+    ThreadSlot& threadSlot();
+    void add(ThreadSlot& slot, int stage, int64_t ns);
+    void merge(std::vector<Histogram>& counts,
+               std::vector<uint64_t>& sum_ns) const;
+    void reportLoop(double interval);
+    void report();
+
+    uint64_t id_;
+    bool enabled_;
+    Clock::time_point epoch_;
+    std::vector<std::string> stages_;
+
+    std::vector<std::unique_ptr<ThreadSlot> > slots_;
+    mutable std::mutex slots_mutex_;
+
+    std::string trace_path_;
+    std::vector<TraceEvent> trace_;
+    std::atomic<size_t> trace_next_;
+
+    std::ostream* summary_stream_;
+    std::string prometheus_path_;
+    std::thread reporter_;
+    bool reporting_;
+    std::mutex report_mutex_;
+    std::condition_variable report_cv_;
+};
+
+/**
+ * Times a scope into a stage of Stats; does nothing when stats are off.
+ */
+class StageTimer
+{
+public:
+    StageTimer(Stats& stats, int stage)
+        : stats_(stats.enabled() ? &stats : nullptr),
+          stage_(stage)
+    {
+        if (stats_)
+            start_ = Stats::Clock::now();
+    }
+
+    ~StageTimer()
+    {
+        stop();
+    }
+
+    void stop()
+    {
+        if (stats_)
+            stats_->record(stage_, start_, Stats::Clock::now());
+        stats_ = nullptr;
+    }
+
+private:
+    StageTimer(const StageTimer&);
+    StageTimer& operator=(const StageTimer&);
+
+    Stats* stats_;
+    int stage_;
+    Stats::Clock::time_point start_;
+};
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_STATS_HPP
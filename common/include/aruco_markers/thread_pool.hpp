@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef ARUCO_MARKERS_THREAD_POOL_HPP
+#define ARUCO_MARKERS_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace aruco_markers {
+
+/**
+ * Fixed set of worker threads with one task deque per worker.
+ *
+ * Tasks submitted from outside the pool are spread round-robin over the
+ * workers; tasks submitted by a worker go to its own deque. A worker takes
+ * tasks from the front of its own deque and, once that is empty, steals
+ * from the back of the others, so uneven task costs do not leave cores
+ * idle. The destructor finishes all queued tasks before joining.
+ */
+class ThreadPool
+{
+public:
+    typedef std::function<void()> Task;
+
+    // threads == 0 uses one worker per hardware thread
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    void submit(Task task);
+
+    size_t size() const { return threads_.size(); }
+
+private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(size_t index);
+    bool takeTask(size_t index, Task& task);
+
+    std::vector<std::unique_ptr<Worker> > workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_worker_;
+    std::atomic<size_t> pending_;
+
+    std::mutex mutex_;
+    std::condition_variable available_;
+    bool stopping_;
+};
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_THREAD_POOL_HPP
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_THRESHOLD_HPP
+#define ARUCO_MARKERS_THRESHOLD_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/aruco.hpp>
+#include <vector>
+
+
+namespace aruco_markers {
+
+/**
+ * Window sizes of the adaptive threshold sweep described by the detector
+ * parameters, made odd the way cv::aruco::detectMarkers does.
+ */
+std::vector<int> thresholdWindowSizes(
+    const cv::aruco::DetectorParameters& params);
+
+/**
+ * Adaptive thresholds a gray image for several window sizes at once.
+ *
+ * cv::adaptiveThreshold() box filters the whole image again for every
+ * window size. Here the image is padded once by replicating its border,
+ * one integral image is built from it and each window's local mean is
+ * four lookups into that table, so the cost per window no longer depends
+ * on its size. Rows are processed with OpenCV universal intrinsics (SSE,
+ * AVX2 or NEON, whatever OpenCV was built for) and all windows and row
+ * stripes run in parallel.
+ *
+ * Each binaries[i] equals cv::adaptiveThreshold(gray, ..., 255,
+ * ADAPTIVE_THRESH_MEAN_C, THRESH_BINARY_INV, window_sizes[i], constant)
+ * up to the rounding of the local mean.
+ */
+void thresholdWindows(const cv::Mat& gray, const std::vector<int>& window_sizes,
+                      double constant, std::vector<cv::Mat>& binaries);
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_THRESHOLD_HPP
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_VIDEO_RECORDER_HPP
+#define ARUCO_MARKERS_VIDEO_RECORDER_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/utility.hpp>
+#include <opencv2/videoio.hpp>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "aruco_markers/bounded_queue.hpp"
+#include "aruco_markers/frame_pool.hpp"
+
+
+namespace aruco_markers {
+
+/**
+ * Records frames to a video file with the encoder on its own thread.
+ *
+ * write() copies the frame into a pooled buffer and queues it, so the
+ * caller only pays for the copy. When the encoder falls behind and the
+ * queue is full, DROP_OLDEST discards the oldest queued frame and counts
+ * it, keeping the caller's latency unchanged; BLOCK waits for the encoder
+ * instead and records every frame. A recorder writes a single file.
+ */
+class VideoRecorder
+{
+public:
+    enum Policy
+    {
+        DROP_OLDEST,
+        BLOCK
+    };
+
+    explicit VideoRecorder(size_t queue_capacity = 8,
+                           Policy policy = DROP_OLDEST);
+    ~VideoRecorder();
+
+    /**
+     * Opens the file and starts the encoder. codec is a FourCC such as
+     * "MJPG", "XVID" or "mp4v"; when empty it is chosen from the file
+     * extension. Returns false if the container or codec is not supported.
+     */
+    bool open(const std::string& path, const std::string& codec, double fps,
+              cv::Size frame_size, bool color = true);
+
+    /**
+     * Queues a copy of the frame, converted to BGR when it is gray and the
+     * file was opened in color. Returns false when the recorder is not
+     * open.
+     */
+    bool write(const cv::Mat& frame);
+
+    /**
+     * Encodes the frames still queued and closes the file.
+     */
+    void close();
+
+    bool isOpened() const { return thread_.joinable(); }
+
+    uint64_t written() const { return written_; }
+    uint64_t dropped() const { return dropped_; }
+
+    /**
+     * FourCC used for a file when no codec is given: mp4v for .mp4 and
+     * .mov, MJPG otherwise.
+     */
+    static std::string defaultCodec(const std::string& path);
+
+private:
+    VideoRecorder(const VideoRecorder&);
+    VideoRecorder& operator=(const VideoRecorder&);
+
+    bool enqueue(const cv::Mat& copy);
+    void encodeLoop();
+
+    Policy policy_;
+    bool color_;
+    cv::VideoWriter writer_;
+    BoundedQueue<cv::Mat> queue_;
+    FramePool buffers_;
+    std::thread thread_;
+    std::atomic<uint64_t> written_;
+    std::atomic<uint64_t> dropped_;
+};
+
+/**
+ * Recording options of a tool's command line, from the rec, codec,
+ * recfps, recqueue and recpolicy keys.
+ */
+struct RecorderOptions
+{
+    RecorderOptions()
+        : fps(0.0), queue_capacity(8), policy(VideoRecorder::DROP_OLDEST) {}
+
+    std::string path;       // empty when not recording
+    std::string codec;      // empty to choose from the extension
+    double fps;             // 0 for the frame rate of the source
+    size_t queue_capacity;
+    VideoRecorder::Policy policy;
+};
+
+/**
+ * Reads the recording keys; prints the reason to stderr and returns false
+ * for an unknown policy or an empty queue.
+ */
+bool readRecorderOptions(const cv::CommandLineParser& parser,
+                         RecorderOptions& options);
+
+/**
+ * Opens recorder when options ask for a recording, at source_fps unless a
+ * frame rate was given, or 30 when neither is known. Prints the reason to
+ * stderr and returns false when the file cannot be opened.
+ */
+bool openRecorder(const RecorderOptions& options, double source_fps,
+                  cv::Size frame_size, VideoRecorder& recorder);
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_VIDEO_RECORDER_HPP
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef ARUCO_MARKERS_VIDEO_SOURCE_HPP
+#define ARUCO_MARKERS_VIDEO_SOURCE_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+
+namespace aruco_markers {
+
+/**
+ * What a -v argument names. Frames of a file can be read at any pace and
+ * carry their own time, a camera or a stream delivers them live.
+ */
+enum SourceKind
+{
+    CAMERA_SOURCE, // a camera id such as "0"
+    FILE_SOURCE,   // a video file or an image sequence such as img_%04d.png
+    STREAM_SOURCE  // a url such as rtsp://host/stream
+};
+
+/**
+ * Only a source that is an integer as a whole is a camera id, so "2.mp4"
+ * is a file. Urls other than file:// are streams.
+ */
+SourceKind sourceKind(const cv::String& source);
+
+/**
+ * Opens a camera id, file or url and returns its kind. Check
+ * capture.isOpened() for success.
+ */
+SourceKind openSource(cv::VideoCapture& capture, const cv::String& source);
+
+} // namespace aruco_markers
+
+#endif // ARUCO_MARKERS_VIDEO_SOURCE_HPP
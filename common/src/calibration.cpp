@@ -0,0 +1,559 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "aruco_markers/calibration.hpp"
+
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+
+namespace aruco_markers {
+
+namespace {
+
+const char kCacheMagic[8] = { 'A', 'R', 'U', 'C', 'O', 'U', 'N', 'D' };
+const uint32_t kCacheVersion = 1;
+
+struct CacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    uint32_t reserved;
+    uint64_t source_hash;
+    double camera_matrix[9];
+};
+
+bool readMat(std::FILE* file, cv::Mat& mat, cv::Size size, int type)
+{
+    mat.create(size, type);
+    size_t bytes = mat.total() * mat.elemSize();
+    return std::fread(mat.data, 1, bytes, file) == bytes;
+}
+
+bool writeMat(std::FILE* file, const cv::Mat& mat)
+{
+    cv::Mat continuous = mat.isContinuous() ? mat : mat.clone();
+    size_t bytes = continuous.total() * continuous.elemSize();
+    return std::fwrite(continuous.data, 1, bytes, file) == bytes;
+}
+
+// calibration.yml -> calibration
+std::string stripExtension(const std::string& path)
+{
+    std::string base = path;
+    size_t dot = base.find_last_of('.');
+    size_t slash = base.find_last_of("/\\");
+    if (dot != std::string::npos &&
+        (slash == std::string::npos || dot > slash))
+        base.erase(dot);
+    return base;
+}
+
+const char kProfilesMagic[8] = { 'A', 'R', 'U', 'C', 'O', 'C', 'A', 'L' };
+const uint32_t kProfilesVersion = 1;
+const int kMaxDistCoeffs = 14;
+
+struct ProfilesHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t source_hash;
+};
+
+struct ProfileRecord
+{
+    int32_t width;
+    int32_t height;
+    int32_t dist_count;
+    int32_t reserved;
+    double camera_matrix[9];
+    double dist_coeffs[kMaxDistCoeffs];
+};
+
+bool readProfile(const cv::FileNode& node, CameraIntrinsics& intrinsics)
+{
+    int width = 0, height = 0;
+    cv::Mat camera_matrix, dist_coeffs;
+    node["image_width"] >> width;
+    node["image_height"] >> height;
+    node["camera_matrix"] >> camera_matrix;
+    node["distortion_coefficients"] >> dist_coeffs;
+    if (width <= 0 || height <= 0 || camera_matrix.rows != 3 ||
+        camera_matrix.cols != 3 || dist_coeffs.total() > kMaxDistCoeffs)
+        return false;
+    intrinsics.size = cv::Size(width, height);
+    camera_matrix.convertTo(intrinsics.camera_matrix, CV_64F);
+    if (!dist_coeffs.empty())
+        dist_coeffs.reshape(1, 1).convertTo(intrinsics.dist_coeffs, CV_64F);
+    return true;
+}
+
+bool sameAspect(cv::Size a, cv::Size b)
+{
+    // within 1%, sensor modes round their sizes differently
+    double cross_a = static_cast<double>(a.width) * b.height;
+    double cross_b = static_cast<double>(b.width) * a.height;
+    return std::abs(cross_a - cross_b) <= 0.01 * std::max(cross_a, cross_b);
+}
+
+// Moves a completely written file over path; a tool loading the cache at
+// the same time reads the old file or the new one, never a partial one.
+bool replaceFile(const std::string& temporary, const std::string& path)
+{
+    if (std::rename(temporary.c_str(), path.c_str()) == 0)
+        return true;
+    // rename does not replace an existing file on Windows
+    std::remove(path.c_str());
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+} // namespace
+
+bool hashFile(const std::string& path, uint64_t& hash)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    hash = 14695981039346656037ULL;
+    unsigned char buffer[4096];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            hash ^= buffer[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+    std::fclose(file);
+    return true;
+}
+
+CameraIntrinsics CameraIntrinsics::scaled(cv::Size target) const
+{
+    CameraIntrinsics result;
+    result.size = target;
+    result.dist_coeffs = dist_coeffs.clone();
+    result.camera_matrix = camera_matrix.clone();
+    if (target == size)
+        return result;
+
+    double sx = static_cast<double>(target.width) / size.width;
+    double sy = static_cast<double>(target.height) / size.height;
+    cv::Mat& k = result.camera_matrix;
+    k.at<double>(0, 0) *= sx;
+    k.at<double>(0, 1) *= sx;
+    k.at<double>(1, 1) *= sy;
+    // pixel centers, not pixel edges, sit at integer coordinates
+    k.at<double>(0, 2) = (k.at<double>(0, 2) + 0.5) * sx - 0.5;
+    k.at<double>(1, 2) = (k.at<double>(1, 2) + 0.5) * sy - 0.5;
+    return result;
+}
+
+std::string CalibrationProfiles::cachePath(const std::string& path)
+{
+    return stripExtension(path) + ".profiles.bin";
+}
+
+bool CalibrationProfiles::load(const std::string& path)
+{
+    profiles_.clear();
+    uint64_t hash = 0;
+    if (!hashFile(path, hash))
+        return false;
+    std::string cache = cachePath(path);
+    if (readCache(cache, hash))
+        return true;
+
+    if (!parse(path))
+        return false;
+    if (!writeCache(cache, hash))
+        std::cerr << "failed to write calibration cache: " << cache
+                  << std::endl;
+    return true;
+}
+
+bool CalibrationProfiles::parse(const std::string& path)
+{
+    cv::FileStorage fs(path, cv::FileStorage::READ);
+    if (!fs.isOpened())
+        return false;
+
+    cv::FileNode list = fs["profiles"];
+    if (list.isSeq()) {
+        for (size_t i = 0; i < list.size(); i++) {
+            CameraIntrinsics intrinsics;
+            if (!readProfile(list[static_cast<int>(i)], intrinsics)) {
+                profiles_.clear();
+                return false;
+            }
+            add(intrinsics);
+        }
+    } else {
+        CameraIntrinsics intrinsics;
+        if (!readProfile(fs.root(), intrinsics))
+            return false;
+        add(intrinsics);
+    }
+    return !profiles_.empty();
+}
+
+bool CalibrationProfiles::save(const std::string& path) const
+{
+    cv::FileStorage fs(path, cv::FileStorage::WRITE);
+    if (!fs.isOpened())
+        return false;
+    fs << "profiles" << "[";
+    for (size_t i = 0; i < profiles_.size(); i++) {
+        fs << "{";
+        fs << "image_width" << profiles_[i].size.width;
+        fs << "image_height" << profiles_[i].size.height;
+        fs << "camera_matrix" << profiles_[i].camera_matrix;
+        fs << "distortion_coefficients" << profiles_[i].dist_coeffs;
+        fs << "}";
+    }
+    fs << "]";
+    return true;
+}
+
+void CalibrationProfiles::add(const CameraIntrinsics& intrinsics)
+{
+    for (size_t i = 0; i < profiles_.size(); i++) {
+        if (profiles_[i].size == intrinsics.size) {
+            profiles_[i] = intrinsics;
+            return;
+        }
+    }
+    profiles_.push_back(intrinsics);
+}
+
+int CalibrationProfiles::select(cv::Size size,
+                                CameraIntrinsics& intrinsics) const
+{
+    int best = -1;
+    for (size_t i = 0; i < profiles_.size(); i++) {
+        const cv::Size& candidate = profiles_[i].size;
+        if (candidate == size) {
+            best = static_cast<int>(i);
+            break;
+        }
+        // scaling down from a larger calibration loses the least
+        if ((size.area() == 0 || sameAspect(candidate, size)) &&
+            (best < 0 || candidate.area() > profiles_[best].size.area()))
+            best = static_cast<int>(i);
+    }
+    if (best < 0)
+        return -1;
+    intrinsics = profiles_[best].scaled(size.area() == 0
+                                        ? profiles_[best].size : size);
+    return best;
+}
+
+bool CalibrationProfiles::readCache(const std::string& path, uint64_t hash)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    ProfilesHeader header;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+              std::equal(kProfilesMagic, kProfilesMagic + 8, header.magic) &&
+              header.version == kProfilesVersion &&
+              header.source_hash == hash && header.count > 0;
+    for (uint32_t i = 0; ok && i < header.count; i++) {
+        ProfileRecord record;
+        ok = std::fread(&record, sizeof(record), 1, file) == 1 &&
+             record.width > 0 && record.height > 0 &&
+             record.dist_count >= 0 && record.dist_count <= kMaxDistCoeffs;
+        if (!ok)
+            break;
+        CameraIntrinsics intrinsics;
+        intrinsics.size = cv::Size(record.width, record.height);
+        cv::Mat(3, 3, CV_64F, record.camera_matrix)
+            .copyTo(intrinsics.camera_matrix);
+        if (record.dist_count > 0)
+            cv::Mat(1, record.dist_count, CV_64F, record.dist_coeffs)
+                .copyTo(intrinsics.dist_coeffs);
+        profiles_.push_back(intrinsics);
+    }
+    std::fclose(file);
+
+    if (!ok)
+        profiles_.clear();
+    return ok;
+}
+
+bool CalibrationProfiles::writeCache(const std::string& path,
+                                     uint64_t hash) const
+{
+    ProfilesHeader header;
+    std::copy(kProfilesMagic, kProfilesMagic + 8, header.magic);
+    header.version = kProfilesVersion;
+    header.count = static_cast<uint32_t>(profiles_.size());
+    header.source_hash = hash;
+
+    std::string temporary = path + ".tmp";
+    std::FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    for (size_t i = 0; ok && i < profiles_.size(); i++) {
+        const CameraIntrinsics& intrinsics = profiles_[i];
+        ProfileRecord record = ProfileRecord();
+        record.width = intrinsics.size.width;
+        record.height = intrinsics.size.height;
+        record.dist_count = static_cast<int32_t>(
+            intrinsics.dist_coeffs.total());
+        for (int k = 0; k < 9; k++)
+            record.camera_matrix[k] =
+                intrinsics.camera_matrix.at<double>(k / 3, k % 3);
+        for (int k = 0; k < record.dist_count; k++)
+            record.dist_coeffs[k] = intrinsics.dist_coeffs.at<double>(k);
+        ok = std::fwrite(&record, sizeof(record), 1, file) == 1;
+    }
+    ok = std::fclose(file) == 0 && ok;
+    ok = ok && replaceFile(temporary, path);
+    if (!ok)
+        std::remove(temporary.c_str());
+    return ok;
+}
+
+bool loadIntrinsics(const std::string& path, cv::Size frame_size,
+                    cv::Mat& camera_matrix, cv::Mat& dist_coeffs)
+{
+    CalibrationProfiles profiles;
+    if (!profiles.load(path)) {
+        std::cerr << "no calibration in " << path << std::endl;
+        return false;
+    }
+    CameraIntrinsics intrinsics;
+    int used = profiles.select(frame_size, intrinsics);
+    if (used < 0) {
+        std::cerr << "no calibration in " << path << " has the aspect ratio "
+                  << "of " << frame_size << std::endl;
+        return false;
+    }
+    if (profiles.profiles()[used].size != intrinsics.size)
+        std::cerr << "scaling the calibration of "
+                  << profiles.profiles()[used].size << " in " << path
+                  << " to " << intrinsics.size << std::endl;
+    camera_matrix = intrinsics.camera_matrix;
+    dist_coeffs = intrinsics.dist_coeffs;
+    return true;
+}
+
+bool parseResolution(const std::string& text, cv::Size& size)
+{
+    int width = 0, height = 0;
+    if (std::sscanf(text.c_str(), "%dx%d", &width, &height) != 2 ||
+        width <= 0 || height <= 0)
+        return false;
+    size = cv::Size(width, height);
+    return true;
+}
+
+cv::Size setResolution(cv::VideoCapture& capture, cv::Size size)
+{
+    if (size.area() > 0) {
+        capture.set(cv::CAP_PROP_FRAME_WIDTH, size.width);
+        capture.set(cv::CAP_PROP_FRAME_HEIGHT, size.height);
+    }
+    return cv::Size(static_cast<int>(capture.get(cv::CAP_PROP_FRAME_WIDTH)),
+                    static_cast<int>(capture.get(cv::CAP_PROP_FRAME_HEIGHT)));
+}
+
+bool checkFrameSize(const cv::Mat& frame, cv::Size expected)
+{
+    if (frame.size() == expected)
+        return true;
+    std::cerr << "frames arrive as " << frame.size() << " but the capture "
+              << "reported " << expected << ", stopping" << std::endl;
+    return false;
+}
+
+UndistortionCache::UndistortionCache()
+{
+}
+
+std::string UndistortionCache::cachePath(const std::string& calibration_path,
+                                         cv::Size size)
+{
+    return cv::format("%s.undistort-%dx%d.bin",
+                      stripExtension(calibration_path).c_str(), size.width,
+                      size.height);
+}
+
+bool UndistortionCache::load(const std::string& calibration_path,
+                             const cv::Mat& camera_matrix,
+                             const cv::Mat& dist_coeffs, cv::Size size)
+{
+    if (camera_matrix.empty() || size.area() == 0)
+        return false;
+
+    uint64_t hash = 0;
+    bool hashed = hashFile(calibration_path, hash);
+    std::string path = cachePath(calibration_path, size);
+    if (hashed && read(path, hash, size))
+        return true;
+
+    build(camera_matrix, dist_coeffs, size);
+    if (hashed && !write(path, hash))
+        std::cerr << "failed to write undistortion cache: " << path
+                  << std::endl;
+    return true;
+}
+
+void UndistortionCache::build(const cv::Mat& camera_matrix,
+                              const cv::Mat& dist_coeffs, cv::Size size)
+{
+    camera_matrix.convertTo(camera_matrix_, CV_64F);
+
+    cv::initUndistortRectifyMap(camera_matrix_, dist_coeffs, cv::Mat(),
+                                camera_matrix_, size, CV_16SC2, map1_, map2_);
+
+    // undistort every pixel center once; corners are looked up later
+    std::vector<cv::Point2f> pixels;
+    pixels.reserve(size.area());
+    for (int y = 0; y < size.height; y++)
+        for (int x = 0; x < size.width; x++)
+            pixels.push_back(cv::Point2f(static_cast<float>(x),
+                                         static_cast<float>(y)));
+
+    std::vector<cv::Point2f> normalized;
+    cv::undistortPoints(pixels, normalized, camera_matrix_, dist_coeffs);
+    cv::Mat(normalized).reshape(2, size.height).copyTo(lut_);
+}
+
+bool UndistortionCache::read(const std::string& path, uint64_t hash,
+                             cv::Size size)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    CacheHeader header;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+              std::equal(kCacheMagic, kCacheMagic + 8, header.magic) &&
+              header.version == kCacheVersion &&
+              header.source_hash == hash &&
+              header.width == size.width && header.height == size.height;
+    ok = ok && readMat(file, map1_, size, CV_16SC2) &&
+         readMat(file, map2_, size, CV_16UC1) &&
+         readMat(file, lut_, size, CV_32FC2);
+    std::fclose(file);
+
+    if (!ok) {
+        map1_.release();
+        map2_.release();
+        lut_.release();
+        return false;
+    }
+    cv::Mat(3, 3, CV_64F, header.camera_matrix).copyTo(camera_matrix_);
+    return true;
+}
+
+bool UndistortionCache::write(const std::string& path, uint64_t hash) const
+{
+    CacheHeader header;
+    std::copy(kCacheMagic, kCacheMagic + 8, header.magic);
+    header.version = kCacheVersion;
+    header.width = lut_.cols;
+    header.height = lut_.rows;
+    header.reserved = 0;
+    header.source_hash = hash;
+    for (int i = 0; i < 9; i++)
+        header.camera_matrix[i] = camera_matrix_.at<double>(i / 3, i % 3);
+
+    std::string temporary = path + ".tmp";
+    std::FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              writeMat(file, map1_) && writeMat(file, map2_) &&
+              writeMat(file, lut_);
+    ok = std::fclose(file) == 0 && ok;
+    ok = ok && replaceFile(temporary, path);
+    if (!ok)
+        std::remove(temporary.c_str());
+    return ok;
+}
+
+void UndistortionCache::undistortImage(const cv::Mat& image,
+                                       cv::Mat& rectified) const
+{
+    cv::remap(image, rectified, map1_, map2_, cv::INTER_LINEAR);
+}
+
+cv::Point2f UndistortionCache::lookup(const cv::Point2f& pixel) const
+{
+    float x = std::min(std::max(pixel.x, 0.0f), lut_.cols - 1.001f);
+    float y = std::min(std::max(pixel.y, 0.0f), lut_.rows - 1.001f);
+    int x0 = static_cast<int>(x);
+    int y0 = static_cast<int>(y);
+    float fx = x - x0;
+    float fy = y - y0;
+
+    const cv::Vec2f* row0 = lut_.ptr<cv::Vec2f>(y0);
+    const cv::Vec2f* row1 = lut_.ptr<cv::Vec2f>(y0 + 1);
+    cv::Vec2f top = row0[x0] * (1.0f - fx) + row0[x0 + 1] * fx;
+    cv::Vec2f bottom = row1[x0] * (1.0f - fx) + row1[x0 + 1] * fx;
+    cv::Vec2f value = top * (1.0f - fy) + bottom * fy;
+    return cv::Point2f(value[0], value[1]);
+}
+
+void UndistortionCache::normalize(const MarkerCorners& corners,
+                                  MarkerCorners& normalized) const
+{
+    normalized.resize(corners.size());
+    for (size_t i = 0; i < corners.size(); i++) {
+        normalized[i].resize(corners[i].size());
+        for (size_t k = 0; k < corners[i].size(); k++)
+            normalized[i][k] = lookup(corners[i][k]);
+    }
+}
+
+void UndistortionCache::rectify(const MarkerCorners& corners,
+                                MarkerCorners& rectified) const
+{
+    double fx = camera_matrix_.at<double>(0, 0);
+    double fy = camera_matrix_.at<double>(1, 1);
+    double cx = camera_matrix_.at<double>(0, 2);
+    double cy = camera_matrix_.at<double>(1, 2);
+
+    normalize(corners, rectified);
+    for (size_t i = 0; i < rectified.size(); i++) {
+        for (size_t k = 0; k < rectified[i].size(); k++) {
+            cv::Point2f& p = rectified[i][k];
+            p.x = static_cast<float>(fx * p.x + cx);
+            p.y = static_cast<float>(fy * p.y + cy);
+        }
+    }
+}
+
+} // namespace aruco_markers
@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "aruco_markers/detection.hpp"
+
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+
+
+namespace aruco_markers {
+
+namespace {
+
+struct TileResult
+{
+    cv::Rect tile;
+    MarkerCorners corners;
+    std::vector<int> ids;
+};
+
+cv::Point2f markerCenter(const std::vector<cv::Point2f>& corners)
+{
+    cv::Point2f center(0, 0);
+    for (size_t k = 0; k < corners.size(); k++)
+        center += corners[k];
+    return center * (1.0f / corners.size());
+}
+
+float distanceToEdge(const cv::Point2f& p, const cv::Rect& rect)
+{
+    return std::min(std::min(p.x - rect.x, rect.x + rect.width - p.x),
+                    std::min(p.y - rect.y, rect.y + rect.height - p.y));
+}
+
+template <typename T>
+void readParameter(const cv::FileStorage& fs, const char* name, T& value)
+{
+    cv::FileNode node = fs[name];
+    if (!node.empty())
+        node >> value;
+}
+
+} // namespace
+
+MarkerDetector::MarkerDetector(
+    const cv::Ptr<cv::aruco::Dictionary>& dictionary,
+    const cv::Ptr<cv::aruco::DetectorParameters>& params)
+    : dictionary_(dictionary),
+      params_(params),
+      decimation_(1),
+      tiles_(1),
+      overlap_(0)
+{
+}
+
+void MarkerDetector::setDecimation(int factor)
+{
+    CV_Assert(factor >= 1);
+    decimation_ = factor;
+}
+
+void MarkerDetector::setTiling(int tiles, int overlap)
+{
+    CV_Assert(tiles >= 1 && overlap >= 0);
+    tiles_ = tiles;
+    overlap_ = overlap;
+}
+
+void MarkerDetector::detect(const cv::Mat& image, MarkerCorners& corners,
+                            std::vector<int>& ids) const
+{
+    detect(image, corners, ids, params_);
+}
+
+void MarkerDetector::detect(
+    const cv::Mat& image, MarkerCorners& corners, std::vector<int>& ids,
+    const cv::Ptr<cv::aruco::DetectorParameters>& params) const
+{
+    if (tiles_ > 1 && image.cols / tiles_ >= overlap_ &&
+        image.rows / tiles_ >= overlap_)
+        detectTiled(image, params, corners, ids);
+    else
+        detectImage(image, params, corners, ids);
+}
+
+void MarkerDetector::detectImage(
+    const cv::Mat& image,
+    const cv::Ptr<cv::aruco::DetectorParameters>& params,
+    MarkerCorners& corners, std::vector<int>& ids) const
+{
+    if (decimation_ > 1 && detectDecimated(image, params, corners, ids))
+        return;
+    cv::aruco::detectMarkers(image, dictionary_, corners, ids, params);
+}
+
+bool MarkerDetector::detectDecimated(
+    const cv::Mat& image,
+    const cv::Ptr<cv::aruco::DetectorParameters>& params,
+    MarkerCorners& corners, std::vector<int>& ids) const
+{
+    double scale = 1.0 / decimation_;
+    cv::Mat small;
+    cv::resize(image, small, cv::Size(), scale, scale, cv::INTER_AREA);
+
+    cv::aruco::detectMarkers(small, dictionary_, corners, ids, params);
+    if (ids.empty())
+        return false;
+
+    // map pixel centers of the small image back onto the full image
+    float factor = static_cast<float>(decimation_);
+    float shift = 0.5f * (factor - 1.0f);
+    for (size_t i = 0; i < corners.size(); i++) {
+        for (size_t k = 0; k < corners[i].size(); k++) {
+            corners[i][k].x = corners[i][k].x * factor + shift;
+            corners[i][k].y = corners[i][k].y * factor + shift;
+        }
+    }
+
+    refineCorners(image, corners, decimation_ + 2);
+    return true;
+}
+
+void MarkerDetector::detectTiled(
+    const cv::Mat& image,
+    const cv::Ptr<cv::aruco::DetectorParameters>& frame_params,
+    MarkerCorners& corners, std::vector<int>& ids) const
+{
+    cv::Rect bounds(0, 0, image.cols, image.rows);
+    int step_x = (image.cols + tiles_ - 1) / tiles_;
+    int step_y = (image.rows + tiles_ - 1) / tiles_;
+    int half_overlap = (overlap_ + 1) / 2;
+
+    std::vector<TileResult> results(tiles_ * tiles_);
+    for (int ty = 0; ty < tiles_; ty++) {
+        for (int tx = 0; tx < tiles_; tx++) {
+            cv::Point tl(tx * step_x - half_overlap,
+                         ty * step_y - half_overlap);
+            cv::Point br((tx + 1) * step_x + half_overlap,
+                         (ty + 1) * step_y + half_overlap);
+            results[ty * tiles_ + tx].tile = cv::Rect(tl, br) & bounds;
+        }
+    }
+
+    double frame_side = std::max(image.cols, image.rows);
+    cv::parallel_for_(cv::Range(0, static_cast<int>(results.size())),
+                      [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; i++) {
+            TileResult& result = results[i];
+
+            // perimeter rates are relative to the image side, keep them
+            // relative to the full frame
+            cv::Ptr<cv::aruco::DetectorParameters> params =
+                cv::makePtr<cv::aruco::DetectorParameters>(*frame_params);
+            double rate_scale = frame_side /
+                std::max(result.tile.width, result.tile.height);
+            params->minMarkerPerimeterRate *= rate_scale;
+            params->maxMarkerPerimeterRate *= rate_scale;
+
+            detectImage(image(result.tile), params, result.corners,
+                        result.ids);
+
+            cv::Point2f offset(static_cast<float>(result.tile.x),
+                               static_cast<float>(result.tile.y));
+            for (size_t m = 0; m < result.corners.size(); m++)
+                for (size_t k = 0; k < result.corners[m].size(); k++)
+                    result.corners[m][k] += offset;
+        }
+    });
+
+    // A marker inside an overlap is found by several tiles; keep the
+    // detection whose tile contains it with the widest margin.
+    corners.clear();
+    ids.clear();
+    std::vector<cv::Point2f> centers;
+    std::vector<float> margins;
+    for (size_t t = 0; t < results.size(); t++) {
+        const TileResult& result = results[t];
+        for (size_t m = 0; m < result.ids.size(); m++) {
+            const std::vector<cv::Point2f>& marker = result.corners[m];
+            cv::Point2f center = markerCenter(marker);
+            float margin = distanceToEdge(center, result.tile);
+            float radius = 0.5f * static_cast<float>(
+                cv::norm(marker[0] - marker[2]));
+
+            size_t j = 0;
+            for (; j < ids.size(); j++) {
+                if (ids[j] == result.ids[m] &&
+                    cv::norm(centers[j] - center) < radius)
+                    break;
+            }
+
+            if (j == ids.size()) {
+                corners.push_back(marker);
+                ids.push_back(result.ids[m]);
+                centers.push_back(center);
+                margins.push_back(margin);
+            } else if (margin > margins[j]) {
+                corners[j] = marker;
+                centers[j] = center;
+                margins[j] = margin;
+            }
+        }
+    }
+}
+
+bool readDetectorParameters(const std::string& path,
+                            cv::Ptr<cv::aruco::DetectorParameters>& params)
+{
+    cv::FileStorage fs(path, cv::FileStorage::READ);
+    if (!fs.isOpened())
+        return false;
+    cv::aruco::DetectorParameters& p = *params;
+    readParameter(fs, "adaptiveThreshWinSizeMin", p.adaptiveThreshWinSizeMin);
+    readParameter(fs, "adaptiveThreshWinSizeMax", p.adaptiveThreshWinSizeMax);
+    readParameter(fs, "adaptiveThreshWinSizeStep",
+                  p.adaptiveThreshWinSizeStep);
+    readParameter(fs, "adaptiveThreshConstant", p.adaptiveThreshConstant);
+    readParameter(fs, "minMarkerPerimeterRate", p.minMarkerPerimeterRate);
+    readParameter(fs, "maxMarkerPerimeterRate", p.maxMarkerPerimeterRate);
+    readParameter(fs, "polygonalApproxAccuracyRate",
+                  p.polygonalApproxAccuracyRate);
+    readParameter(fs, "minCornerDistanceRate", p.minCornerDistanceRate);
+    readParameter(fs, "minDistanceToBorder", p.minDistanceToBorder);
+    readParameter(fs, "minMarkerDistanceRate", p.minMarkerDistanceRate);
+    readParameter(fs, "cornerRefinementMethod", p.cornerRefinementMethod);
+    readParameter(fs, "cornerRefinementWinSize", p.cornerRefinementWinSize);
+    readParameter(fs, "cornerRefinementMaxIterations",
+                  p.cornerRefinementMaxIterations);
+    readParameter(fs, "cornerRefinementMinAccuracy",
+                  p.cornerRefinementMinAccuracy);
+    readParameter(fs, "markerBorderBits", p.markerBorderBits);
+    readParameter(fs, "perspectiveRemovePixelPerCell",
+                  p.perspectiveRemovePixelPerCell);
+    readParameter(fs, "perspectiveRemoveIgnoredMarginPerCell",
+                  p.perspectiveRemoveIgnoredMarginPerCell);
+    readParameter(fs, "maxErroneousBitsInBorderRate",
+                  p.maxErroneousBitsInBorderRate);
+    readParameter(fs, "minOtsuStdDev", p.minOtsuStdDev);
+    readParameter(fs, "errorCorrectionRate", p.errorCorrectionRate);
+    return true;
+}
+
+void refineCorners(const cv::Mat& image, MarkerCorners& corners,
+                   int win_size)
+{
+    if (corners.empty())
+        return;
+
+    cv::Mat gray;
+    if (image.channels() == 3)
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    else
+        gray = image;
+
+    std::vector<cv::Point2f> points;
+    points.reserve(corners.size() * 4);
+    for (size_t i = 0; i < corners.size(); i++)
+        points.insert(points.end(), corners[i].begin(), corners[i].end());
+
+    // cornerSubPix needs 2 * win_size + 5 to fit into the image
+    int max_win = (std::min(gray.cols, gray.rows) - 6) / 2;
+    win_size = std::max(1, std::min(win_size, max_win));
+    cv::cornerSubPix(gray, points, cv::Size(win_size, win_size),
+                     cv::Size(-1, -1),
+                     cv::TermCriteria(cv::TermCriteria::COUNT +
+                                      cv::TermCriteria::EPS, 30, 0.01));
+
+    size_t n = 0;
+    for (size_t i = 0; i < corners.size(); i++)
+        for (size_t k = 0; k < corners[i].size(); k++)
+            corners[i][k] = points[n++];
+}
+
+} // namespace aruco_markers
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/detector_tuner.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+
+namespace aruco_markers {
+
+DetectorAutoTuner::DetectorAutoTuner(
+    const cv::Ptr<cv::aruco::Dictionary>& dictionary,
+    const cv::Ptr<cv::aruco::DetectorParameters>& base,
+    int rescan_interval, double margin)
+    : base_(base),
+      cells_(dictionary->markerSize + 2 * base->markerBorderBits),
+      rescan_interval_(rescan_interval),
+      margin_(margin),
+      decimation_(1),
+      expected_(0),
+      frames_(0),
+      narrowed_frames_(0),
+      full_frames_(0),
+      misses_(0)
+{
+    CV_Assert(rescan_interval >= 1 && margin >= 1.0);
+}
+
+DetectorAutoTuner::DetectorAutoTuner(const MarkerDetector& detector,
+                                     int rescan_interval, double margin)
+    : DetectorAutoTuner(detector.dictionary(), detector.parameters(),
+                        rescan_interval, margin)
+{
+    decimation_ = detector.decimation();
+}
+
+void DetectorAutoTuner::setDecimation(int factor)
+{
+    CV_Assert(factor >= 1);
+    std::lock_guard<std::mutex> lock(mutex_);
+    decimation_ = factor;
+}
+
+cv::Ptr<cv::aruco::DetectorParameters> DetectorAutoTuner::next()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool rescan = frames_++ % rescan_interval_ == 0;
+    if (!narrowed_ || rescan) {
+        full_frames_++;
+        return base_;
+    }
+    narrowed_frames_++;
+    return narrowed_;
+}
+
+void DetectorAutoTuner::update(
+    const cv::Ptr<cv::aruco::DetectorParameters>& used,
+    const MarkerCorners& corners, cv::Size image_size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    // a marker left the narrowed range, or the view; search fully again
+    if (used != base_ && corners.size() < expected_) {
+        narrowed_ = cv::Ptr<cv::aruco::DetectorParameters>();
+        misses_++;
+        return;
+    }
+    expected_ = corners.size();
+    if (corners.empty())
+        narrowed_ = cv::Ptr<cv::aruco::DetectorParameters>();
+    else
+        narrow(corners, image_size);
+}
+
+void DetectorAutoTuner::narrow(const MarkerCorners& corners,
+                               cv::Size image_size)
+{
+    double min_perimeter = std::numeric_limits<double>::max();
+    double max_perimeter = 0;
+    for (size_t i = 0; i < corners.size(); i++) {
+        double perimeter = 0;
+        for (size_t k = 0; k < corners[i].size(); k++)
+            perimeter += cv::norm(corners[i][k] -
+                                  corners[i][(k + 1) % corners[i].size()]);
+        min_perimeter = std::min(min_perimeter, perimeter);
+        max_perimeter = std::max(max_perimeter, perimeter);
+    }
+
+    cv::Ptr<cv::aruco::DetectorParameters> params =
+        cv::makePtr<cv::aruco::DetectorParameters>(*base_);
+
+    // perimeter rates are relative to the larger image side
+    double side = std::max(image_size.width, image_size.height);
+    params->minMarkerPerimeterRate = std::max(
+        base_->minMarkerPerimeterRate, min_perimeter / side / margin_);
+    params->maxMarkerPerimeterRate = std::min(
+        base_->maxMarkerPerimeterRate, max_perimeter / side * margin_);
+
+    // Keep the windows of the base grid from the largest one not above the
+    // smallest cell size up to the first one covering two of the largest
+    // cells, on the image the detector actually thresholds.
+    int first = base_->adaptiveThreshWinSizeMin;
+    int step = std::max(1, base_->adaptiveThreshWinSizeStep);
+    int count = (base_->adaptiveThreshWinSizeMax - first) / step + 1;
+    double scale = 1.0 / (4.0 * cells_ * decimation_);
+    double min_cell = min_perimeter * scale / margin_;
+    double max_cell = max_perimeter * scale * margin_;
+    int low = 0, high = count - 1;
+    while (low + 1 < count && first + (low + 1) * step <= min_cell)
+        low++;
+    while (high > low && first + (high - 1) * step >= 2 * max_cell)
+        high--;
+    params->adaptiveThreshWinSizeMin = first + low * step;
+    params->adaptiveThreshWinSizeMax = first + high * step;
+
+    narrowed_ = params;
+}
+
+void DetectorAutoTuner::detect(const MarkerDetector& detector,
+                               const cv::Mat& image, MarkerCorners& corners,
+                               std::vector<int>& ids)
+{
+    cv::Ptr<cv::aruco::DetectorParameters> params = next();
+    detector.detect(image, corners, ids, params);
+    update(params, corners, image.size());
+}
+
+uint64_t DetectorAutoTuner::narrowedFrames() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return narrowed_frames_;
+}
+
+uint64_t DetectorAutoTuner::fullFrames() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return full_frames_;
+}
+
+uint64_t DetectorAutoTuner::misses() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+void DetectorAutoTuner::report(std::ostream& out) const
+{
+    out << "auto-tuning: " << narrowedFrames() << " frames searched "
+        << "narrowed, " << fullFrames() << " fully, " << misses()
+        << " misses" << std::endl;
+}
+
+bool readDetectorOptions(const cv::CommandLineParser& parser,
+                         cv::Ptr<cv::aruco::DetectorParameters>& params,
+                         int& tune_interval)
+{
+    tune_interval = parser.get<int>("tune");
+    if (tune_interval < 0) {
+        std::cerr << "tuning interval must not be negative" << std::endl;
+        return false;
+    }
+    params = cv::aruco::DetectorParameters::create();
+    if (parser.has("dp") &&
+        !readDetectorParameters(parser.get<cv::String>("dp"), params)) {
+        std::cerr << "failed to read detector parameters: "
+                  << parser.get<cv::String>("dp") << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace aruco_markers
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "aruco_markers/frame_pool.hpp"
+
+
+namespace aruco_markers {
+
+namespace {
+
+// Whether the pool holds the only reference to the buffer.
+bool isFree(const cv::Mat& buffer)
+{
+    return buffer.u && CV_XADD(&buffer.u->refcount, 0) == 1;
+}
+
+} // namespace
+
+FramePool::FramePool(size_t capacity)
+    : capacity_(capacity),
+      next_(0),
+      misses_(0)
+{
+}
+
+void FramePool::setCapacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacity;
+    if (buffers_.size() > capacity_)
+        buffers_.resize(capacity_);
+    next_ = 0;
+}
+
+cv::Mat FramePool::acquire(cv::Size size, int type)
+{
+    if (size.area() == 0)
+        return cv::Mat();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t n = 0; n < buffers_.size(); n++) {
+        size_t i = (next_ + n) % buffers_.size();
+        cv::Mat& buffer = buffers_[i];
+        if (!isFree(buffer))
+            continue;
+        if (buffer.size() != size || buffer.type() != type)
+            buffer.create(size, type);
+        next_ = i + 1;
+        return buffer;
+    }
+
+    if (buffers_.size() < capacity_) {
+        buffers_.push_back(cv::Mat(size, type));
+        next_ = 0;
+        return buffers_.back();
+    }
+
+    misses_++;
+    return cv::Mat(size, type);
+}
+
+size_t FramePool::allocated() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return buffers_.size();
+}
+
+size_t FramePool::misses() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+} // namespace aruco_markers
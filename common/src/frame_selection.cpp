@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/frame_selection.hpp"
+
+#include <opencv2/calib3d.hpp>
+#include <algorithm>
+#include <cmath>
+
+
+namespace aruco_markers {
+
+namespace {
+
+const int kGridCols = 12;
+const int kGridRows = 9;
+
+// Orientation difference at which a view counts as fully new.
+const double kDistinctAngle = CV_PI / 6;
+
+struct ViewFeatures
+{
+    std::vector<int> cells;
+    double markers;
+    bool posed;
+    cv::Matx33d rotation;
+};
+
+ViewFeatures describeView(const CalibrationView& view,
+                          const cv::Ptr<cv::aruco::Board>& board,
+                          cv::Size image_size, const cv::Matx33d& camera)
+{
+    ViewFeatures features;
+    features.markers = static_cast<double>(view.ids.size()) /
+                       std::max<size_t>(1, board->ids.size());
+    features.posed = false;
+
+    std::vector<char> hit(kGridCols * kGridRows, 0);
+    for (size_t i = 0; i < view.corners.size(); i++) {
+        for (size_t k = 0; k < view.corners[i].size(); k++) {
+            const cv::Point2f& p = view.corners[i][k];
+            int col = static_cast<int>(p.x * kGridCols / image_size.width);
+            int row = static_cast<int>(p.y * kGridRows / image_size.height);
+            if (col >= 0 && col < kGridCols && row >= 0 && row < kGridRows)
+                hit[row * kGridCols + col] = 1;
+        }
+    }
+    for (size_t c = 0; c < hit.size(); c++)
+        if (hit[c])
+            features.cells.push_back(static_cast<int>(c));
+
+    std::vector<cv::Point3f> object_points;
+    std::vector<cv::Point2f> image_points;
+    cv::aruco::getBoardObjectAndImagePoints(board, view.corners, view.ids,
+                                            object_points, image_points);
+    if (object_points.size() >= 4) {
+        cv::Vec3d rvec, tvec;
+        if (cv::solvePnP(object_points, image_points, camera, cv::noArray(),
+                         rvec, tvec, false, cv::SOLVEPNP_IPPE)) {
+            cv::Rodrigues(rvec, features.rotation);
+            features.posed = true;
+        }
+    }
+    return features;
+}
+
+double rotationDistance(const cv::Matx33d& a, const cv::Matx33d& b)
+{
+    // trace of a^T b without forming the product
+    double trace = 0;
+    for (int r = 0; r < 3; r++)
+        for (int c = 0; c < 3; c++)
+            trace += a(r, c) * b(r, c);
+    return std::acos(std::max(-1.0, std::min(1.0, 0.5 * (trace - 1.0))));
+}
+
+} // namespace
+
+std::vector<size_t> selectCalibrationViews(
+    const std::vector<CalibrationView>& views,
+    const cv::Ptr<cv::aruco::Board>& board, cv::Size image_size,
+    size_t max_views)
+{
+    std::vector<size_t> candidates;
+    for (size_t v = 0; v < views.size(); v++)
+        if (!views[v].ids.empty())
+            candidates.push_back(v);
+    if (candidates.size() <= max_views)
+        return candidates;
+
+    double focal = std::max(image_size.width, image_size.height);
+    cv::Matx33d camera(focal, 0, 0.5 * image_size.width,
+                       0, focal, 0.5 * image_size.height,
+                       0, 0, 1);
+
+    std::vector<ViewFeatures> features(candidates.size());
+    cv::parallel_for_(cv::Range(0, static_cast<int>(candidates.size())),
+                      [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; i++)
+            features[i] = describeView(views[candidates[i]], board,
+                                       image_size, camera);
+    });
+
+    std::vector<int> covered(kGridCols * kGridRows, 0);
+    std::vector<char> taken(candidates.size(), 0);
+    std::vector<size_t> chosen;
+    std::vector<size_t> selected;
+    while (selected.size() < max_views) {
+        int best = -1;
+        double best_score = -1;
+        for (size_t i = 0; i < candidates.size(); i++) {
+            if (taken[i])
+                continue;
+            const ViewFeatures& view = features[i];
+
+            double coverage = 0;
+            for (size_t c = 0; c < view.cells.size(); c++)
+                coverage += 1.0 / (1 + covered[view.cells[c]]);
+            coverage /= covered.size();
+
+            double diversity = 1.0;
+            if (view.posed) {
+                for (size_t s = 0; s < chosen.size(); s++) {
+                    if (!features[chosen[s]].posed)
+                        continue;
+                    diversity = std::min(diversity, rotationDistance(
+                        view.rotation, features[chosen[s]].rotation) /
+                        kDistinctAngle);
+                }
+            } else {
+                diversity = 0;
+            }
+
+            double score = coverage + diversity + 0.5 * view.markers;
+            if (score > best_score) {
+                best = static_cast<int>(i);
+                best_score = score;
+            }
+        }
+
+        taken[best] = 1;
+        chosen.push_back(best);
+        selected.push_back(candidates[best]);
+        for (size_t c = 0; c < features[best].cells.size(); c++)
+            covered[features[best].cells[c]]++;
+    }
+
+    std::sort(selected.begin(), selected.end());
+    return selected;
+}
+
+} // namespace aruco_markers
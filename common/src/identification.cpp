@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/identification.hpp"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+namespace aruco_markers {
+
+namespace {
+
+inline int popcount(uint64_t value)
+{
+#if defined(__GNUC__)
+    return __builtin_popcountll(value);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return static_cast<int>(__popcnt64(value));
+#else
+    value = value - ((value >> 1) & 0x5555555555555555ULL);
+    value = (value & 0x3333333333333333ULL) +
+            ((value >> 2) & 0x3333333333333333ULL);
+    value = (value + (value >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return static_cast<int>((value * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/**
+ * Packs an NxN bit matrix; N is known at compile time for the predefined
+ * marker sizes so the loops unroll, 0 takes the size from the matrix.
+ */
+template <int N>
+uint64_t packBits(const cv::Mat& bits)
+{
+    const int n = N ? N : bits.rows;
+    uint64_t code = 0;
+    for (int y = 0; y < n; y++) {
+        const uchar* row = bits.ptr<uchar>(y);
+        for (int x = 0; x < n; x++)
+            code = (code << 1) | (row[x] & 1);
+    }
+    return code;
+}
+
+/**
+ * Reads one rotation of a dictionary byte list. Bytes hold the bits row
+ * by row from their highest bit on, the last byte only the remaining bits
+ * in its lowest ones, so appending them yields the packed codeword.
+ */
+uint64_t unpackBytes(const uchar* bytes, int bits)
+{
+    uint64_t code = 0;
+    int n = 0;
+    for (; bits - n >= 8; n += 8)
+        code = (code << 8) | *bytes++;
+    if (bits > n)
+        code = (code << (bits - n)) | *bytes;
+    return code;
+}
+
+} // namespace
+
+MarkerIdentifier::MarkerIdentifier(
+    const cv::Ptr<cv::aruco::Dictionary>& dictionary)
+    : marker_size_(dictionary->markerSize),
+      max_correction_bits_(dictionary->maxCorrectionBits)
+{
+    int bits = marker_size_ * marker_size_;
+    CV_Assert(bits <= 64);
+    int bytes_per_rotation = (bits + 7) / 8;
+
+    const cv::Mat& bytes_list = dictionary->bytesList;
+    codes_.resize(4 * bytes_list.rows);
+    exact_.reserve(codes_.size());
+    for (int m = 0; m < bytes_list.rows; m++) {
+        for (int r = 0; r < 4; r++) {
+            uint64_t code = unpackBytes(bytes_list.ptr<uchar>(m) +
+                                        r * bytes_per_rotation, bits);
+            codes_[4 * m + r] = code;
+            // symmetric markers repeat a codeword, the first rotation wins
+            // as in cv::aruco::Dictionary::identify()
+            exact_.insert(std::make_pair(code, 4 * m + r));
+        }
+    }
+}
+
+uint64_t MarkerIdentifier::pack(const cv::Mat& only_bits)
+{
+    CV_Assert(only_bits.type() == CV_8UC1 && only_bits.rows == only_bits.cols);
+    switch (only_bits.rows) {
+    case 4: return packBits<4>(only_bits);
+    case 5: return packBits<5>(only_bits);
+    case 6: return packBits<6>(only_bits);
+    case 7: return packBits<7>(only_bits);
+    default: return packBits<0>(only_bits);
+    }
+}
+
+bool MarkerIdentifier::identify(const cv::Mat& only_bits, int& id,
+                                int& rotation,
+                                double max_correction_rate) const
+{
+    CV_Assert(only_bits.rows == marker_size_);
+    uint64_t code = pack(only_bits);
+    id = -1;
+
+    // Markers of a dictionary are more than twice the correctable bits
+    // apart, so an exact match is also the first one within the limit.
+    std::unordered_map<uint64_t, int>::const_iterator found =
+        exact_.find(code);
+    if (found != exact_.end()) {
+        id = found->second / 4;
+        rotation = found->second % 4;
+        return true;
+    }
+
+    int max_bits = static_cast<int>(max_correction_bits_ *
+                                    max_correction_rate);
+    const uint64_t* codes = codes_.data();
+    for (size_t m = 0; m < codes_.size(); m += 4) {
+        int d0 = popcount(codes[m] ^ code);
+        int d1 = popcount(codes[m + 1] ^ code);
+        int d2 = popcount(codes[m + 2] ^ code);
+        int d3 = popcount(codes[m + 3] ^ code);
+        if (std::min(std::min(d0, d1), std::min(d2, d3)) > max_bits)
+            continue;
+
+        // the lowest rotation among the closest ones, like OpenCV
+        int best = 0, best_distance = d0;
+        if (d1 < best_distance) { best = 1; best_distance = d1; }
+        if (d2 < best_distance) { best = 2; best_distance = d2; }
+        if (d3 < best_distance) { best = 3; }
+        id = static_cast<int>(m / 4);
+        rotation = best;
+        return true;
+    }
+    return false;
+}
+
+int MarkerIdentifier::distance(const cv::Mat& only_bits, int id) const
+{
+    CV_Assert(id >= 0 && id < size());
+    uint64_t code = pack(only_bits);
+    int best = marker_size_ * marker_size_;
+    for (int r = 0; r < 4; r++)
+        best = std::min(best, popcount(codes_[4 * id + r] ^ code));
+    return best;
+}
+
+} // namespace aruco_markers
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/incremental_calibration.hpp"
+
+#include <opencv2/calib3d.hpp>
+#include <algorithm>
+#include <cmath>
+
+
+namespace aruco_markers {
+
+IncrementalCalibrator::IncrementalCalibrator(
+    const cv::Ptr<cv::aruco::Board>& board, cv::Size image_size, int flags,
+    const cv::Mat& camera_matrix)
+    : board_(board),
+      image_size_(image_size),
+      flags_(flags),
+      tolerance_(0.005),
+      min_views_(5),
+      stable_runs_(3),
+      has_estimate_(false),
+      stable_(0),
+      solving_(0),
+      solved_(0),
+      stopping_(false)
+{
+    if (!camera_matrix.empty())
+        estimate_.camera_matrix = camera_matrix.clone();
+    worker_ = std::thread(&IncrementalCalibrator::run, this);
+}
+
+IncrementalCalibrator::~IncrementalCalibrator()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    changed_.notify_all();
+    if (worker_.joinable())
+        worker_.join();
+}
+
+void IncrementalCalibrator::setConvergence(double tolerance, int min_views,
+                                           int stable_runs)
+{
+    CV_Assert(tolerance > 0 && min_views >= 1 && stable_runs >= 1);
+    std::lock_guard<std::mutex> lock(mutex_);
+    tolerance_ = tolerance;
+    min_views_ = min_views;
+    stable_runs_ = stable_runs;
+}
+
+void IncrementalCalibrator::addView(const CalibrationView& view)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        views_.push_back(view);
+    }
+    changed_.notify_all();
+}
+
+bool IncrementalCalibrator::estimate(CalibrationEstimate& estimate) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!has_estimate_)
+        return false;
+    estimate = estimate_;
+    return true;
+}
+
+std::string IncrementalCalibrator::failure() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failure_;
+}
+
+bool IncrementalCalibrator::finish(CalibrationEstimate& estimate)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] {
+        return views_.size() < static_cast<size_t>(min_views_) ||
+               (solved_ == views_.size() && solving_ == 0);
+    });
+    stopping_ = true;
+    // estimate_ is from the latest successful run, which may be short of
+    // the final views when the run over all of them failed
+    bool ok = has_estimate_ &&
+              static_cast<size_t>(estimate_.views) == views_.size();
+    if (ok)
+        estimate = estimate_;
+    lock.unlock();
+
+    changed_.notify_all();
+    if (worker_.joinable())
+        worker_.join();
+    return ok;
+}
+
+void IncrementalCalibrator::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        changed_.wait(lock, [this] {
+            return stopping_ ||
+                   (views_.size() > solved_ &&
+                    views_.size() >= static_cast<size_t>(min_views_));
+        });
+        if (stopping_)
+            break;
+
+        std::vector<CalibrationView> views(views_);
+        CalibrationEstimate result;
+        result.camera_matrix = estimate_.camera_matrix.clone();
+        result.dist_coeffs = estimate_.dist_coeffs.clone();
+        solving_ = views.size();
+        lock.unlock();
+
+        std::string failure;
+        bool ok = calibrate(views, result, failure);
+
+        lock.lock();
+        solving_ = 0;
+        solved_ = views.size();
+        failure_ = failure;
+        if (ok) {
+            // uncertainty and drift of the intrinsics, relative to focal
+            double focal = 0.5 * (result.camera_matrix.at<double>(0, 0) +
+                                  result.camera_matrix.at<double>(1, 1));
+            double spread = 0;
+            for (int i = 0; i < 4; i++)
+                spread = std::max(spread,
+                                  result.std_deviations.at<double>(i));
+            double drift = 0;
+            if (has_estimate_) {
+                for (int i = 0; i < 2; i++)
+                    drift = std::max(drift, std::abs(
+                        result.camera_matrix.at<double>(i, i) -
+                        estimate_.camera_matrix.at<double>(i, i)));
+            }
+            bool within = has_estimate_ && spread < tolerance_ * focal &&
+                          drift < tolerance_ * focal;
+            stable_ = within ? stable_ + 1 : 0;
+            result.converged = stable_ >= stable_runs_;
+            estimate_ = result;
+            has_estimate_ = true;
+        }
+        changed_.notify_all();
+    }
+}
+
+bool IncrementalCalibrator::calibrate(
+    const std::vector<CalibrationView>& views,
+    CalibrationEstimate& result, std::string& failure) const
+{
+    MarkerCorners corners;
+    std::vector<int> ids;
+    std::vector<int> counts;
+    for (size_t v = 0; v < views.size(); v++) {
+        counts.push_back(static_cast<int>(views[v].ids.size()));
+        corners.insert(corners.end(), views[v].corners.begin(),
+                       views[v].corners.end());
+        ids.insert(ids.end(), views[v].ids.begin(), views[v].ids.end());
+    }
+
+    int flags = flags_;
+    // a seed matrix without a solved distortion only carries the aspect
+    // ratio, which calibrateCamera reads without the guess flag
+    if (!result.dist_coeffs.empty())
+        flags |= cv::CALIB_USE_INTRINSIC_GUESS;
+
+    try {
+        std::vector<cv::Mat> rvecs, tvecs;
+        cv::Mat std_extrinsics, per_view_errors;
+        result.error = cv::aruco::calibrateCameraAruco(
+            corners, ids, counts, board_, image_size_, result.camera_matrix,
+            result.dist_coeffs, rvecs, tvecs, result.std_deviations,
+            std_extrinsics, per_view_errors, flags);
+    } catch (const cv::Exception& e) {
+        // too few or degenerate views so far, the next view may fix it
+        failure = e.what();
+        return false;
+    }
+    result.views = static_cast<int>(views.size());
+    return true;
+}
+
+} // namespace aruco_markers
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/luma_capture.hpp"
+
+#include <iostream>
+#include <opencv2/imgproc.hpp>
+
+
+namespace aruco_markers {
+
+LumaCapture::LumaCapture(cv::VideoCapture& capture)
+    : capture_(capture), format_(BGR)
+{
+}
+
+LumaCapture::Format LumaCapture::configure()
+{
+    CV_Assert(capture_.isOpened());
+    format_ = BGR;
+    // preferred order: no conversion at all, then the usual webcam format
+    if (!requestRaw(cv::VideoWriter::fourcc('G', 'R', 'E', 'Y'), GREY) &&
+        !requestRaw(cv::VideoWriter::fourcc('Y', 'U', 'Y', 'V'), YUYV) &&
+        !requestRaw(cv::VideoWriter::fourcc('N', 'V', '1', '2'), NV12))
+        capture_.set(cv::CAP_PROP_CONVERT_RGB, 1);
+    size_ = cv::Size(static_cast<int>(capture_.get(cv::CAP_PROP_FRAME_WIDTH)),
+                     static_cast<int>(capture_.get(cv::CAP_PROP_FRAME_HEIGHT)));
+    // a raw buffer can only be shaped with the frame size, a backend that
+    // does not report one has to convert
+    if (format_ != BGR && size_.area() <= 0) {
+        capture_.set(cv::CAP_PROP_CONVERT_RGB, 1);
+        format_ = BGR;
+    }
+    return format_;
+}
+
+bool LumaCapture::requestRaw(int fourcc, Format format)
+{
+    // a backend that cannot switch the format keeps its own
+    capture_.set(cv::CAP_PROP_FOURCC, fourcc);
+    if (static_cast<int>(capture_.get(cv::CAP_PROP_FOURCC)) != fourcc)
+        return false;
+    if (!capture_.set(cv::CAP_PROP_CONVERT_RGB, 0))
+        return false;
+    format_ = format;
+    return true;
+}
+
+bool LumaCapture::retrieve(cv::Mat& luma)
+{
+    if (format_ == BGR) {
+        if (!capture_.retrieve(raw_))
+            return false;
+        if (raw_.channels() == 1)
+            raw_.copyTo(luma);
+        else
+            cv::cvtColor(raw_, luma, cv::COLOR_BGR2GRAY);
+        return true;
+    }
+
+    if (!capture_.retrieve(raw_) || raw_.empty())
+        return false;
+    // backends hand out the raw buffer either as one row of bytes or
+    // already shaped; only the byte count per frame is reliable
+    const int width = size_.width, height = size_.height;
+    const size_t bytes = raw_.total() * raw_.elemSize();
+    const size_t pixels = static_cast<size_t>(width) * height;
+    CV_Assert(raw_.isContinuous());
+    const size_t needed = format_ == YUYV ? 2 * pixels : pixels;
+    if (bytes < needed) {
+        std::cerr << "raw " << formatName(format_) << " frame of " << bytes
+                  << " bytes is smaller than the reported size " << size_
+                  << ", stopping" << std::endl;
+        return false;
+    }
+    const cv::Mat bytes_row = raw_.reshape(1, 1);
+    switch (format_) {
+    case GREY:
+    case NV12:
+        // NV12 starts with the Y plane, the interleaved chroma is not read
+        bytes_row.colRange(0, static_cast<int>(pixels)).reshape(1, height)
+            .copyTo(luma);
+        break;
+    case YUYV:
+        cv::cvtColor(bytes_row.colRange(0, static_cast<int>(2 * pixels))
+                         .reshape(2, height),
+                     luma, cv::COLOR_YUV2GRAY_YUYV);
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+const char* LumaCapture::formatName(Format format)
+{
+    switch (format) {
+    case GREY: return "GREY";
+    case YUYV: return "YUYV";
+    case NV12: return "NV12";
+    default:   return "BGR";
+    }
+}
+
+} // namespace aruco_markers
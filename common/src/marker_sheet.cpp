@@ -0,0 +1,395 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/marker_sheet.hpp"
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+
+#include "aruco_markers/identification.hpp"
+
+
+namespace aruco_markers {
+
+namespace {
+
+// Space reserved below a marker for its id, and the size of the id text.
+const double kLabelHeight = 5;
+const double kLabelSize = 3.5;
+
+const double kPointsPerMm = 72 / 25.4;
+
+// Appends a length with at most three decimals, trailing zeros dropped.
+void appendNumber(std::string& out, double value)
+{
+    char text[32];
+    int n = std::snprintf(text, sizeof(text), "%.3f", value);
+    while (n > 0 && text[n - 1] == '0')
+        n--;
+    if (n > 0 && text[n - 1] == '.')
+        n--;
+    out.append(text, n);
+}
+
+bool writeFile(const std::string& path, const std::string& data)
+{
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+} // namespace
+
+MarkerSheets::MarkerSheets(const cv::Ptr<cv::aruco::Dictionary>& dictionary,
+                           const std::vector<int>& ids,
+                           const SheetLayout& layout)
+    : layout_(layout), ids_(ids), runs_(ids.size())
+{
+    MarkerIdentifier identifier(dictionary);
+    const int n = identifier.markerSize();
+    const int border = layout_.border_bits;
+    cells_ = n + 2 * border;
+    for (size_t i = 0; i < ids_.size(); i++)
+        CV_Assert(ids_[i] >= 0 && ids_[i] < identifier.size());
+
+    cv::parallel_for_(cv::Range(0, static_cast<int>(ids_.size())),
+                      [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; i++) {
+            uint64_t code = identifier.codeword(ids_[i], 0);
+            std::vector<Run>& runs = runs_[i];
+            for (int y = 0; y < cells_; y++) {
+                int start = -1;
+                for (int x = 0; x <= cells_; x++) {
+                    bool black = false;
+                    if (x < cells_) {
+                        int by = y - border;
+                        int bx = x - border;
+                        black = by < 0 || by >= n || bx < 0 || bx >= n ||
+                                !((code >> (n * n - 1 - (by * n + bx))) & 1);
+                    }
+                    if (black && start < 0) {
+                        start = x;
+                    } else if (!black && start >= 0) {
+                        Run run = {y, start, x - start};
+                        runs.push_back(run);
+                        start = -1;
+                    }
+                }
+            }
+        }
+    });
+
+    double pitch_x = layout_.marker_length + layout_.gap;
+    double pitch_y = layout_.marker_length + layout_.gap +
+                     (layout_.labels ? kLabelHeight : 0);
+    // the last column and row need no gap after them; the epsilon keeps
+    // layouts that fit exactly, e.g. boards, from losing one to rounding
+    columns_ = std::max(0, static_cast<int>(std::floor(
+        (layout_.page_width - 2 * layout_.margin + layout_.gap) / pitch_x +
+        1e-9)));
+    rows_ = std::max(0, static_cast<int>(std::floor(
+        (layout_.page_height - 2 * layout_.margin + layout_.gap) / pitch_y +
+        1e-9)));
+    int per_page = markersPerPage();
+    pages_ = per_page > 0
+                 ? (static_cast<int>(ids_.size()) + per_page - 1) / per_page
+                 : 0;
+}
+
+cv::Point2d MarkerSheets::position(size_t index) const
+{
+    size_t slot = index % markersPerPage();
+    double pitch_x = layout_.marker_length + layout_.gap;
+    double pitch_y = layout_.marker_length + layout_.gap +
+                     (layout_.labels ? kLabelHeight : 0);
+    // columns are centred on the page, rows start at the top margin
+    double width = columns_ * pitch_x - layout_.gap;
+    double left = (layout_.page_width - width) / 2;
+    return cv::Point2d(left + (slot % columns_) * pitch_x,
+                       layout_.margin + (slot / columns_) * pitch_y);
+}
+
+void MarkerSheets::pageRange(int page, size_t& first, size_t& last) const
+{
+    CV_Assert(page >= 0 && page < pages_);
+    first = static_cast<size_t>(page) * markersPerPage();
+    last = std::min(ids_.size(), first + markersPerPage());
+}
+
+std::string MarkerSheets::svg(int page) const
+{
+    size_t first, last;
+    pageRange(page, first, last);
+    double cell = layout_.marker_length / cells_;
+
+    std::string out;
+    out.reserve(4096 + (last - first) * 64 * cells_);
+    out += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+           "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"";
+    appendNumber(out, layout_.page_width);
+    out += "mm\" height=\"";
+    appendNumber(out, layout_.page_height);
+    out += "mm\" viewBox=\"0 0 ";
+    appendNumber(out, layout_.page_width);
+    out += ' ';
+    appendNumber(out, layout_.page_height);
+    out += "\">\n<path fill=\"#000\" d=\"";
+    for (size_t i = first; i < last; i++) {
+        cv::Point2d corner = position(i);
+        const std::vector<Run>& runs = runs_[i];
+        for (size_t r = 0; r < runs.size(); r++) {
+            out += 'M';
+            appendNumber(out, corner.x + runs[r].start * cell);
+            out += ' ';
+            appendNumber(out, corner.y + runs[r].row * cell);
+            out += 'h';
+            appendNumber(out, runs[r].length * cell);
+            out += 'v';
+            appendNumber(out, cell);
+            out += "h-";
+            appendNumber(out, runs[r].length * cell);
+            out += 'z';
+        }
+        out += '\n';
+    }
+    out += "\"/>\n";
+
+    if (layout_.labels) {
+        out += "<g font-family=\"Helvetica,Arial,sans-serif\" font-size=\"";
+        appendNumber(out, kLabelSize);
+        out += "\">\n";
+        for (size_t i = first; i < last; i++) {
+            cv::Point2d corner = position(i);
+            out += "<text x=\"";
+            appendNumber(out, corner.x);
+            out += "\" y=\"";
+            appendNumber(out, corner.y + layout_.marker_length + kLabelSize);
+            out += "\">";
+            out += std::to_string(ids_[i]);
+            out += "</text>\n";
+        }
+        out += "</g>\n";
+    }
+    out += "</svg>\n";
+    return out;
+}
+
+cv::Mat MarkerSheets::raster(int page, double dpi) const
+{
+    size_t first, last;
+    pageRange(page, first, last);
+    double scale = dpi / 25.4;
+    double cell = layout_.marker_length / cells_;
+
+    cv::Mat image(cvRound(layout_.page_height * scale),
+                  cvRound(layout_.page_width * scale), CV_8UC1,
+                  cv::Scalar(255));
+    cv::Rect bounds(0, 0, image.cols, image.rows);
+    for (size_t i = first; i < last; i++) {
+        cv::Point2d corner = position(i);
+        const std::vector<Run>& runs = runs_[i];
+        for (size_t r = 0; r < runs.size(); r++) {
+            // round both edges so neighbouring cells share them exactly
+            int x0 = cvRound((corner.x + runs[r].start * cell) * scale);
+            int x1 = cvRound(
+                (corner.x + (runs[r].start + runs[r].length) * cell) * scale);
+            int y0 = cvRound((corner.y + runs[r].row * cell) * scale);
+            int y1 = cvRound((corner.y + (runs[r].row + 1) * cell) * scale);
+            cv::Rect rect = cv::Rect(x0, y0, x1 - x0, y1 - y0) & bounds;
+            if (rect.area() > 0)
+                image(rect).setTo(cv::Scalar(0));
+        }
+    }
+
+    if (layout_.labels) {
+        // Hershey simplex digits are about 22 units high at scale 1
+        double font_scale = kLabelSize * scale / 22;
+        int thickness = std::max(1, cvRound(font_scale * 2));
+        for (size_t i = first; i < last; i++) {
+            cv::Point2d corner = position(i);
+            cv::Point origin(cvRound(corner.x * scale),
+                             cvRound((corner.y + layout_.marker_length +
+                                      kLabelSize) * scale));
+            cv::putText(image, std::to_string(ids_[i]), origin,
+                        cv::FONT_HERSHEY_SIMPLEX, font_scale, cv::Scalar(0),
+                        thickness, cv::LINE_AA);
+        }
+    }
+    return image;
+}
+
+std::string MarkerSheets::pdfContent(int page) const
+{
+    size_t first, last;
+    pageRange(page, first, last);
+    double cell = layout_.marker_length / cells_;
+
+    std::string out;
+    out.reserve(1024 + (last - first) * 48 * cells_);
+    // work in millimetres from the top left like the other outputs
+    out += "q ";
+    appendNumber(out, kPointsPerMm);
+    out += " 0 0 -";
+    appendNumber(out, kPointsPerMm);
+    out += " 0 ";
+    appendNumber(out, layout_.page_height * kPointsPerMm);
+    out += " cm\n0 g\n";
+    for (size_t i = first; i < last; i++) {
+        cv::Point2d corner = position(i);
+        const std::vector<Run>& runs = runs_[i];
+        for (size_t r = 0; r < runs.size(); r++) {
+            appendNumber(out, corner.x + runs[r].start * cell);
+            out += ' ';
+            appendNumber(out, corner.y + runs[r].row * cell);
+            out += ' ';
+            appendNumber(out, runs[r].length * cell);
+            out += ' ';
+            appendNumber(out, cell);
+            out += " re\n";
+        }
+    }
+    out += "f\n";
+
+    if (layout_.labels) {
+        for (size_t i = first; i < last; i++) {
+            cv::Point2d corner = position(i);
+            // the text matrix flips y back so the ids read upright
+            out += "BT /F1 ";
+            appendNumber(out, kLabelSize);
+            out += " Tf 1 0 0 -1 ";
+            appendNumber(out, corner.x);
+            out += ' ';
+            appendNumber(out, corner.y + layout_.marker_length + kLabelSize);
+            out += " Tm (";
+            out += std::to_string(ids_[i]);
+            out += ") Tj ET\n";
+        }
+    }
+    out += "Q\n";
+    return out;
+}
+
+bool MarkerSheets::writeSvg(const std::string& filename) const
+{
+    std::atomic<bool> ok(true);
+    cv::parallel_for_(cv::Range(0, pages_), [&](const cv::Range& range) {
+        for (int page = range.start; page < range.end; page++) {
+            if (!writeFile(pageFileName(filename, page), svg(page)))
+                ok = false;
+        }
+    });
+    return ok;
+}
+
+bool MarkerSheets::writeRaster(const std::string& filename, double dpi) const
+{
+    std::atomic<bool> ok(true);
+    cv::parallel_for_(cv::Range(0, pages_), [&](const cv::Range& range) {
+        for (int page = range.start; page < range.end; page++) {
+            if (!cv::imwrite(pageFileName(filename, page), raster(page, dpi)))
+                ok = false;
+        }
+    });
+    return ok;
+}
+
+bool MarkerSheets::writePdf(const std::string& filename) const
+{
+    std::vector<std::string> contents(pages_);
+    cv::parallel_for_(cv::Range(0, pages_), [&](const cv::Range& range) {
+        for (int page = range.start; page < range.end; page++)
+            contents[page] = pdfContent(page);
+    });
+
+    // objects: 1 catalog, 2 page tree, 3 font, then page and content
+    // stream for every page
+    int objects = 3 + 2 * pages_;
+    std::vector<size_t> offsets(objects + 1, 0);
+    std::string out = "%PDF-1.4\n%\xe2\xe3\xcf\xd3\n";
+
+    offsets[1] = out.size();
+    out += "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n";
+    offsets[2] = out.size();
+    out += "2 0 obj\n<< /Type /Pages /Count " + std::to_string(pages_) +
+           " /Kids [";
+    for (int page = 0; page < pages_; page++)
+        out += ' ' + std::to_string(4 + 2 * page) + " 0 R";
+    out += " ] >>\nendobj\n";
+    offsets[3] = out.size();
+    out += "3 0 obj\n<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>"
+           "\nendobj\n";
+
+    for (int page = 0; page < pages_; page++) {
+        int object = 4 + 2 * page;
+        offsets[object] = out.size();
+        out += std::to_string(object) +
+               " 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 ";
+        appendNumber(out, layout_.page_width * kPointsPerMm);
+        out += ' ';
+        appendNumber(out, layout_.page_height * kPointsPerMm);
+        out += "] /Resources << /Font << /F1 3 0 R >> >> /Contents " +
+               std::to_string(object + 1) + " 0 R >>\nendobj\n";
+        offsets[object + 1] = out.size();
+        out += std::to_string(object + 1) + " 0 obj\n<< /Length " +
+               std::to_string(contents[page].size()) + " >>\nstream\n";
+        out += contents[page];
+        out += "endstream\nendobj\n";
+        std::string().swap(contents[page]);
+    }
+
+    size_t xref = out.size();
+    out += "xref\n0 " + std::to_string(objects + 1) +
+           "\n0000000000 65535 f \n";
+    for (int object = 1; object <= objects; object++) {
+        char entry[24];
+        std::snprintf(entry, sizeof(entry), "%010lu 00000 n \n",
+                      static_cast<unsigned long>(offsets[object]));
+        out += entry;
+    }
+    out += "trailer\n<< /Size " + std::to_string(objects + 1) +
+           " /Root 1 0 R >>\nstartxref\n" + std::to_string(xref) +
+           "\n%%EOF\n";
+    return writeFile(filename, out);
+}
+
+std::string MarkerSheets::pageFileName(const std::string& filename,
+                                       int page) const
+{
+    if (pages_ <= 1)
+        return filename;
+    size_t slash = filename.find_last_of("/\\");
+    size_t dot = filename.find_last_of('.');
+    if (dot == std::string::npos ||
+        (slash != std::string::npos && dot < slash))
+        dot = filename.size();
+    char number[16];
+    std::snprintf(number, sizeof(number), "_%03d", page + 1);
+    return filename.substr(0, dot) + number + filename.substr(dot);
+}
+
+} // namespace aruco_markers
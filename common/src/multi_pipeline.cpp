@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/multi_pipeline.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <utility>
+
+
+namespace aruco_markers {
+
+MultiCameraPipeline::MultiCameraPipeline(size_t workers)
+    : tolerance_(0.02),
+      workers_(workers ? workers
+                       : std::max(1u, std::thread::hardware_concurrency())),
+      window_(2),
+      stopped_(false)
+{
+}
+
+MultiCameraPipeline::~MultiCameraPipeline()
+{
+    stop();
+}
+
+size_t MultiCameraPipeline::addCamera(const CaptureStage& capture,
+                                      const ClockStage& clock)
+{
+    std::unique_ptr<Camera> camera(new Camera);
+    camera->capture = capture;
+    camera->clock = clock;
+    cameras_.push_back(std::move(camera));
+    return cameras_.size() - 1;
+}
+
+void MultiCameraPipeline::setDetection(const ProcessStage& stage)
+{
+    detection_ = stage;
+}
+
+void MultiCameraPipeline::setPose(const ProcessStage& stage)
+{
+    pose_ = stage;
+}
+
+void MultiCameraPipeline::setOutput(const OutputStage& stage)
+{
+    output_ = stage;
+}
+
+void MultiCameraPipeline::setSyncTolerance(double seconds)
+{
+    tolerance_ = seconds;
+}
+
+double MultiCameraPipeline::elapsed() const
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start_).count();
+}
+
+uint64_t MultiCameraPipeline::dropped(size_t camera) const
+{
+    return cameras_[camera]->dropped;
+}
+
+void MultiCameraPipeline::run()
+{
+    CV_Assert(!cameras_.empty() && output_);
+
+    start_ = std::chrono::steady_clock::now();
+
+    // enough frames per camera to keep the pool busy when all cameras
+    // deliver at once, but no more, so one camera cannot starve the rest
+    window_ = std::max<size_t>(2, (2 * workers_ + cameras_.size() - 1) /
+                                  cameras_.size());
+    for (size_t c = 0; c < cameras_.size(); c++) {
+        cameras_[c]->ordered.reset(new ReorderBuffer<Frame>(window_));
+        // frames in flight, the one being captured and the one output
+        cameras_[c]->frames.setCapacity(window_ + 2);
+    }
+    pool_.reset(new ThreadPool(workers_));
+
+    std::vector<std::thread> threads;
+    for (size_t c = 0; c < cameras_.size(); c++)
+        threads.push_back(std::thread(&MultiCameraPipeline::captureLoop,
+                                      this, c));
+
+    try {
+        std::vector<Frame> frames(cameras_.size());
+        while (nextSet(frames)) {
+            if (!output_(frames))
+                break;
+        }
+    } catch (...) {
+        fail(std::current_exception());
+    }
+
+    stop();
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    pool_.reset();
+
+    if (error_)
+        std::rethrow_exception(error_);
+}
+
+void MultiCameraPipeline::stop()
+{
+    stopped_ = true;
+    for (size_t c = 0; c < cameras_.size(); c++)
+        if (cameras_[c]->ordered)
+            cameras_[c]->ordered->cancel();
+}
+
+void MultiCameraPipeline::captureLoop(size_t camera_index)
+{
+    Camera& camera = *cameras_[camera_index];
+    int64_t index = 0;
+    try {
+        while (!stopped_) {
+            std::shared_ptr<Frame> frame = std::make_shared<Frame>();
+            frame->image = camera.frames.acquire(camera.frame_size,
+                                                 camera.frame_type);
+            if (!camera.capture(frame->image))
+                break;
+            camera.frame_size = frame->image.size();
+            camera.frame_type = frame->image.type();
+            frame->index = index;
+            frame->timestamp = camera.clock ? camera.clock(index)
+                                            : elapsed();
+            if (!camera.ordered->waitForSlot(index))
+                break;
+            pool_->submit(std::bind(&MultiCameraPipeline::processFrame, this,
+                                    camera_index, frame));
+            index++;
+        }
+    } catch (...) {
+        fail(std::current_exception());
+    }
+    camera.ordered->finish(index);
+}
+
+void MultiCameraPipeline::processFrame(size_t camera,
+                                       const std::shared_ptr<Frame>& frame)
+{
+    if (stopped_)
+        return;
+    try {
+        if (detection_)
+            detection_(camera, *frame);
+        if (pose_)
+            pose_(camera, *frame);
+        cameras_[camera]->ordered->push(frame->index, std::move(*frame));
+    } catch (...) {
+        fail(std::current_exception());
+    }
+}
+
+bool MultiCameraPipeline::nextSet(std::vector<Frame>& frames)
+{
+    for (size_t c = 0; c < cameras_.size(); c++)
+        if (!cameras_[c]->ordered->pop(frames[c]))
+            return false;
+
+    // Replace the oldest frame by its camera's next one until all capture
+    // times are within the tolerance of the newest.
+    while (true) {
+        size_t oldest = 0;
+        double newest = frames[0].timestamp;
+        for (size_t c = 1; c < frames.size(); c++) {
+            if (frames[c].timestamp < frames[oldest].timestamp)
+                oldest = c;
+            newest = std::max(newest, frames[c].timestamp);
+        }
+        if (newest - frames[oldest].timestamp <= tolerance_)
+            return true;
+        cameras_[oldest]->dropped++;
+        if (!cameras_[oldest]->ordered->pop(frames[oldest]))
+            return false;
+    }
+}
+
+void MultiCameraPipeline::fail(std::exception_ptr error)
+{
+    {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        if (!error_)
+            error_ = error;
+    }
+    stop();
+}
+
+} // namespace aruco_markers
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/overlay.hpp"
+
+#include <opencv2/aruco.hpp>
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cstdio>
+
+
+namespace aruco_markers {
+
+namespace {
+
+const int kThickness = 3;
+
+const cv::Scalar kCubeColor(255, 0, 0);
+const cv::Scalar kAxisColors[3] = {
+    cv::Scalar(0, 0, 255), cv::Scalar(0, 255, 0), cv::Scalar(255, 0, 0)
+};
+const cv::Scalar kTextColor(0, 252, 124);
+
+inline cv::Point toPoint(const cv::Point2f& p)
+{
+    return cv::Point(cvRound(p.x), cvRound(p.y));
+}
+
+// Resizes a list of polylines without giving up the memory of the lines.
+void resizeLines(std::vector<std::vector<cv::Point> >& lines, size_t count,
+                 size_t points)
+{
+    lines.resize(count);
+    for (size_t i = 0; i < count; i++)
+        lines[i].resize(points);
+}
+
+} // namespace
+
+PoseOverlay::PoseOverlay(Shape shape, float marker_length,
+                         const cv::Mat& camera_matrix,
+                         const cv::Mat& dist_coeffs)
+    : shape_(shape), marker_length_(marker_length), axis_length_(0.1f),
+      camera_matrix_(camera_matrix), dist_coeffs_(dist_coeffs)
+{
+    CV_Assert(marker_length > 0);
+    setModel();
+}
+
+void PoseOverlay::setAxisLength(float length)
+{
+    CV_Assert(length > 0);
+    axis_length_ = length;
+    setModel();
+}
+
+void PoseOverlay::setModel()
+{
+    model_.clear();
+    if (shape_ == CUBE) {
+        float l = marker_length_;
+        float half = l / 2;
+        // top face, then bottom face on the marker
+        model_.push_back(cv::Point3f(half, half, l));
+        model_.push_back(cv::Point3f(half, -half, l));
+        model_.push_back(cv::Point3f(-half, -half, l));
+        model_.push_back(cv::Point3f(-half, half, l));
+        model_.push_back(cv::Point3f(half, half, 0));
+        model_.push_back(cv::Point3f(half, -half, 0));
+        model_.push_back(cv::Point3f(-half, -half, 0));
+        model_.push_back(cv::Point3f(-half, half, 0));
+    } else {
+        model_.push_back(cv::Point3f(0, 0, 0));
+        model_.push_back(cv::Point3f(axis_length_, 0, 0));
+        model_.push_back(cv::Point3f(0, axis_length_, 0));
+        model_.push_back(cv::Point3f(0, 0, axis_length_));
+    }
+}
+
+void PoseOverlay::draw(cv::Mat& image, const MarkerCorners& corners,
+                       const std::vector<int>& ids,
+                       const std::vector<cv::Vec3d>& rvecs,
+                       const std::vector<cv::Vec3d>& tvecs)
+{
+    if (ids.empty())
+        return;
+    cv::aruco::drawDetectedMarkers(image, corners, ids);
+
+    // every marker's vertices in the camera frame, projected at once
+    const size_t markers = std::min(rvecs.size(), tvecs.size());
+    const size_t vertices = model_.size();
+    camera_points_.resize(markers * vertices);
+    visible_.assign(markers, 1);
+    for (size_t i = 0; i < markers; i++) {
+        cv::Matx33d rotation;
+        cv::Rodrigues(rvecs[i], rotation);
+        for (size_t k = 0; k < vertices; k++) {
+            const cv::Point3f& p = model_[k];
+            cv::Vec3d q = rotation * cv::Vec3d(p.x, p.y, p.z) + tvecs[i];
+            camera_points_[i * vertices + k] = cv::Point3f(
+                static_cast<float>(q[0]), static_cast<float>(q[1]),
+                static_cast<float>(q[2]));
+            if (q[2] <= 0)
+                visible_[i] = 0;
+        }
+    }
+    if (markers > 0)
+        cv::projectPoints(camera_points_, cv::Vec3d(0, 0, 0),
+                          cv::Vec3d(0, 0, 0), camera_matrix_, dist_coeffs_,
+                          image_points_);
+
+    size_t shown = 0;
+    for (size_t i = 0; i < markers; i++)
+        shown += visible_[i];
+
+    if (shape_ == CUBE) {
+        // top and bottom face closed, the four vertical edges open
+        resizeLines(closed_, 2 * shown, 4);
+        resizeLines(open_[0], 4 * shown, 2);
+        size_t c = 0, o = 0;
+        for (size_t i = 0; i < markers; i++) {
+            if (!visible_[i])
+                continue;
+            const cv::Point2f* p = &image_points_[i * vertices];
+            for (int k = 0; k < 4; k++) {
+                closed_[c][k] = toPoint(p[k]);
+                closed_[c + 1][k] = toPoint(p[k + 4]);
+                open_[0][o + k][0] = toPoint(p[k]);
+                open_[0][o + k][1] = toPoint(p[k + 4]);
+            }
+            c += 2;
+            o += 4;
+        }
+        cv::polylines(image, closed_, true, kCubeColor, kThickness);
+        cv::polylines(image, open_[0], false, kCubeColor, kThickness);
+    } else {
+        for (int axis = 0; axis < 3; axis++)
+            resizeLines(open_[axis], shown, 2);
+        size_t o = 0;
+        for (size_t i = 0; i < markers; i++) {
+            if (!visible_[i])
+                continue;
+            const cv::Point2f* p = &image_points_[i * vertices];
+            for (int axis = 0; axis < 3; axis++) {
+                open_[axis][o][0] = toPoint(p[0]);
+                open_[axis][o][1] = toPoint(p[axis + 1]);
+            }
+            o++;
+        }
+        for (int axis = 0; axis < 3; axis++)
+            cv::polylines(image, open_[axis], false, kAxisColors[axis],
+                          kThickness);
+    }
+
+    // position of the first marker, formatted once per frame
+    if (!tvecs.empty()) {
+        static const char* labels[3] = { "x", "y", "z" };
+        char text[32];
+        for (int axis = 0; axis < 3; axis++) {
+            std::snprintf(text, sizeof(text), "%s: %8.4g", labels[axis],
+                          tvecs[0][axis]);
+            cv::putText(image, text, cv::Point(10, 30 + 20 * axis),
+                        cv::FONT_HERSHEY_SIMPLEX, 0.6, kTextColor, 1,
+                        cv::LINE_AA);
+        }
+    }
+}
+
+void copyToCanvas(const cv::Mat& image, cv::Mat& canvas)
+{
+    if (image.channels() == 1)
+        cv::cvtColor(image, canvas, cv::COLOR_GRAY2BGR);
+    else if (image.data != canvas.data)
+        image.copyTo(canvas);
+}
+
+} // namespace aruco_markers
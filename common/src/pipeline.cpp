@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "aruco_markers/pipeline.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <utility>
+
+
+namespace aruco_markers {
+
+Pipeline::Pipeline(size_t queue_capacity)
+    : captured_(queue_capacity),
+      detected_(queue_capacity),
+      posed_(queue_capacity),
+      queue_capacity_(queue_capacity),
+      workers_(1),
+      frame_type_(0),
+      stopped_(false)
+{
+}
+
+Pipeline::~Pipeline()
+{
+    stop();
+}
+
+void Pipeline::setCapture(const CaptureStage& stage)
+{
+    capture_ = stage;
+}
+
+void Pipeline::setDetection(const ProcessStage& stage)
+{
+    detection_ = stage;
+}
+
+void Pipeline::setPose(const ProcessStage& stage)
+{
+    pose_ = stage;
+}
+
+void Pipeline::setOutput(const OutputStage& stage)
+{
+    output_ = stage;
+}
+
+void Pipeline::setWorkers(size_t workers)
+{
+    if (workers == 0)
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    workers_ = workers;
+    if (workers_ > 1) {
+        // enough frames in flight to keep every worker busy while the
+        // oldest one is still being processed
+        reordered_.reset(new ReorderBuffer<Frame>(2 * workers_ +
+                                                  queue_capacity_));
+    } else {
+        reordered_.reset();
+    }
+}
+
+void Pipeline::run()
+{
+    CV_Assert(capture_ && output_);
+
+    start_ = std::chrono::steady_clock::now();
+
+    // every frame that can be queued or processed at once, plus the one
+    // being captured and the one being output
+    size_t in_flight = reordered_ ? 2 * workers_ + queue_capacity_
+                                  : 3 * queue_capacity_ + 2;
+    frames_.setCapacity(in_flight + 2);
+
+    std::vector<std::thread> threads;
+    if (reordered_) {
+        pool_.reset(new ThreadPool(workers_));
+        threads.push_back(std::thread(&Pipeline::dispatchLoop, this));
+    } else {
+        threads.push_back(std::thread(&Pipeline::captureLoop, this));
+        threads.push_back(std::thread(&Pipeline::processLoop, this,
+                                      std::cref(detection_),
+                                      std::ref(captured_),
+                                      std::ref(detected_)));
+        threads.push_back(std::thread(&Pipeline::processLoop, this,
+                                      std::cref(pose_), std::ref(detected_),
+                                      std::ref(posed_)));
+    }
+
+    try {
+        Frame frame;
+        while (nextOutput(frame)) {
+            if (!output_(frame))
+                break;
+        }
+    } catch (...) {
+        fail(std::current_exception());
+    }
+
+    stop();
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    pool_.reset();
+
+    if (error_)
+        std::rethrow_exception(error_);
+}
+
+void Pipeline::stop()
+{
+    stopped_ = true;
+    captured_.cancel();
+    detected_.cancel();
+    posed_.cancel();
+    if (reordered_)
+        reordered_->cancel();
+}
+
+bool Pipeline::nextOutput(Frame& frame)
+{
+    if (reordered_)
+        return reordered_->pop(frame);
+    return posed_.pop(frame);
+}
+
+double Pipeline::elapsed() const
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start_).count();
+}
+
+void Pipeline::captureLoop()
+{
+    try {
+        int64_t index = 0;
+        while (!stopped_) {
+            Frame frame;
+            if (!captureFrame(frame, index++))
+                break;
+            if (!captured_.push(std::move(frame)))
+                break;
+        }
+    } catch (...) {
+        fail(std::current_exception());
+    }
+    captured_.close();
+}
+
+bool Pipeline::captureFrame(Frame& frame, int64_t index)
+{
+    // capture into a pooled buffer shaped like the previous frame
+    frame.image = frames_.acquire(frame_size_, frame_type_);
+    if (!capture_(frame.image))
+        return false;
+    frame_size_ = frame.image.size();
+    frame_type_ = frame.image.type();
+    frame.index = index;
+    frame.timestamp = elapsed();
+    return true;
+}
+
+void Pipeline::processLoop(const ProcessStage& stage,
+                           BoundedQueue<Frame>& input,
+                           BoundedQueue<Frame>& output)
+{
+    try {
+        Frame frame;
+        while (input.pop(frame)) {
+            if (stage)
+                stage(frame);
+            if (!output.push(std::move(frame)))
+                break;
+        }
+    } catch (...) {
+        fail(std::current_exception());
+    }
+    output.close();
+}
+
+void Pipeline::dispatchLoop()
+{
+    int64_t index = 0;
+    try {
+        while (!stopped_) {
+            std::shared_ptr<Frame> frame = std::make_shared<Frame>();
+            if (!captureFrame(*frame, index))
+                break;
+            if (!reordered_->waitForSlot(index))
+                break;
+            pool_->submit(std::bind(&Pipeline::processFrame, this, frame));
+            index++;
+        }
+    } catch (...) {
+        fail(std::current_exception());
+    }
+    reordered_->finish(index);
+}
+
+void Pipeline::processFrame(const std::shared_ptr<Frame>& frame)
+{
+    if (stopped_)
+        return;
+    try {
+        if (detection_)
+            detection_(*frame);
+        if (pose_)
+            pose_(*frame);
+        reordered_->push(frame->index, std::move(*frame));
+    } catch (...) {
+        fail(std::current_exception());
+    }
+}
+
+void Pipeline::fail(std::exception_ptr error)
+{
+    {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        if (!error_)
+            error_ = error;
+    }
+    stop();
+}
+
+} // namespace aruco_markers
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/pose.hpp"
+
+#include <opencv2/calib3d.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace aruco_markers {
+
+namespace {
+
+// Below this many markers solving them in parallel costs more than it saves.
+const int kParallelMarkers = 16;
+
+std::vector<cv::Point3f> markerObjectPoints(float marker_length)
+{
+    float half = 0.5f * marker_length;
+    std::vector<cv::Point3f> points;
+    points.push_back(cv::Point3f(-half, half, 0));
+    points.push_back(cv::Point3f(half, half, 0));
+    points.push_back(cv::Point3f(half, -half, 0));
+    points.push_back(cv::Point3f(-half, -half, 0));
+    return points;
+}
+
+double rotationDistance(const cv::Vec3d& a, const cv::Vec3d& b)
+{
+    cv::Matx33d ra, rb;
+    cv::Rodrigues(a, ra);
+    cv::Rodrigues(b, rb);
+    cv::Matx33d difference = ra.t() * rb;
+    double c = 0.5 * (difference(0, 0) + difference(1, 1) +
+                      difference(2, 2) - 1.0);
+    return std::acos(std::max(-1.0, std::min(1.0, c)));
+}
+
+} // namespace
+
+std::vector<cv::Point2f> projectMarkerCorners(float marker_length,
+                                              const cv::Mat& camera_matrix,
+                                              const cv::Mat& dist_coeffs,
+                                              const cv::Vec3d& rvec,
+                                              const cv::Vec3d& tvec)
+{
+    std::vector<cv::Point2f> corners;
+    cv::projectPoints(markerObjectPoints(marker_length), rvec, tvec,
+                      camera_matrix, dist_coeffs, corners);
+    return corners;
+}
+
+SquarePoseSolver::SquarePoseSolver(float marker_length,
+                                   const cv::Mat& camera_matrix,
+                                   const cv::Mat& dist_coeffs)
+    : object_points_(markerObjectPoints(marker_length)),
+      camera_matrix_(camera_matrix),
+      dist_coeffs_(dist_coeffs),
+      warm_start_(false),
+      ambiguity_ratio_(2.0)
+{
+    CV_Assert(marker_length > 0 && camera_matrix.rows == 3 &&
+              camera_matrix.cols == 3);
+    cv::Mat k;
+    camera_matrix.convertTo(k, CV_64F);
+    // reprojection errors come out in normalized units
+    focal_ = 0.5 * (k.at<double>(0, 0) + k.at<double>(1, 1));
+}
+
+void SquarePoseSolver::setWarmStart(bool enabled)
+{
+    warm_start_ = enabled;
+    if (!enabled)
+        reset();
+}
+
+void SquarePoseSolver::setAmbiguityRatio(double ratio)
+{
+    CV_Assert(ratio >= 1.0);
+    ambiguity_ratio_ = ratio;
+}
+
+void SquarePoseSolver::reset()
+{
+    std::lock_guard<std::mutex> lock(previous_mutex_);
+    previous_.clear();
+}
+
+void SquarePoseSolver::solve(const MarkerCorners& corners,
+                             const std::vector<int>& ids,
+                             std::vector<cv::Vec3d>& rvecs,
+                             std::vector<cv::Vec3d>& tvecs,
+                             std::vector<MarkerPose>* poses)
+{
+    CV_Assert(corners.size() == ids.size());
+    int count = static_cast<int>(corners.size());
+    std::vector<MarkerPose> solved(count);
+    rvecs.resize(count);
+    tvecs.resize(count);
+
+    if (count > 0) {
+        std::vector<cv::Point2f> points;
+        points.reserve(4 * count);
+        for (int i = 0; i < count; i++) {
+            CV_Assert(corners[i].size() == 4);
+            points.insert(points.end(), corners[i].begin(), corners[i].end());
+        }
+        std::vector<cv::Point2f> normalized;
+        cv::undistortPoints(points, normalized, camera_matrix_, dist_coeffs_);
+
+        if (count >= kParallelMarkers) {
+            cv::parallel_for_(cv::Range(0, count), [&](const cv::Range& range) {
+                for (int i = range.start; i < range.end; i++)
+                    solveMarker(&normalized[4 * i], solved[i]);
+            });
+        } else {
+            for (int i = 0; i < count; i++)
+                solveMarker(&normalized[4 * i], solved[i]);
+        }
+    }
+
+    if (warm_start_) {
+        std::lock_guard<std::mutex> lock(previous_mutex_);
+        std::map<int, cv::Vec3d> current;
+        for (int i = 0; i < count; i++) {
+            MarkerPose& pose = solved[i];
+            std::map<int, cv::Vec3d>::const_iterator last =
+                previous_.find(ids[i]);
+            if (last != previous_.end() &&
+                pose.alt_error < ambiguity_ratio_ * pose.error &&
+                rotationDistance(last->second, pose.alt_rvec) <
+                rotationDistance(last->second, pose.rvec)) {
+                std::swap(pose.rvec, pose.alt_rvec);
+                std::swap(pose.tvec, pose.alt_tvec);
+                std::swap(pose.error, pose.alt_error);
+            }
+            current[ids[i]] = pose.rvec;
+        }
+        previous_.swap(current);
+    }
+
+    for (int i = 0; i < count; i++) {
+        rvecs[i] = solved[i].rvec;
+        tvecs[i] = solved[i].tvec;
+    }
+    if (poses)
+        poses->swap(solved);
+}
+
+void SquarePoseSolver::solveMarker(const cv::Point2f* normalized,
+                                   MarkerPose& pose) const
+{
+    std::vector<cv::Point2f> image_points(normalized, normalized + 4);
+    std::vector<cv::Mat> rvecs, tvecs;
+    std::vector<double> errors;
+    int solutions = cv::solvePnPGeneric(object_points_, image_points,
+                                        cv::Matx33d::eye(), cv::noArray(),
+                                        rvecs, tvecs, false,
+                                        cv::SOLVEPNP_IPPE_SQUARE,
+                                        cv::noArray(), cv::noArray(), errors);
+    if (solutions == 0) {
+        // degenerate corners, keep the marker but never prefer it
+        pose.rvec = pose.alt_rvec = cv::Vec3d();
+        pose.tvec = pose.alt_tvec = cv::Vec3d();
+        pose.error = pose.alt_error = std::numeric_limits<double>::infinity();
+        return;
+    }
+
+    // solutions are sorted by reprojection error
+    pose.rvec = cv::Vec3d(rvecs[0]);
+    pose.tvec = cv::Vec3d(tvecs[0]);
+    pose.error = errors[0] * focal_;
+    if (solutions > 1) {
+        pose.alt_rvec = cv::Vec3d(rvecs[1]);
+        pose.alt_tvec = cv::Vec3d(tvecs[1]);
+        pose.alt_error = errors[1] * focal_;
+    } else {
+        pose.alt_rvec = pose.rvec;
+        pose.alt_tvec = pose.tvec;
+        pose.alt_error = pose.error;
+    }
+}
+
+} // namespace aruco_markers
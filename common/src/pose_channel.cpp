@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/pose_channel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+namespace aruco_markers {
+
+const char kRingMagic[8] = { 'A', 'R', 'U', 'C', 'O', 'S', 'H', 'M' };
+const uint32_t kRingVersion = 1;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "the ring needs lock-free 64-bit atomics to be shared "
+              "between processes");
+
+/**
+ * Message n lives in slot n % slots. Its sequence is 2n + 1 while the
+ * publisher writes it and 2n + 2 once it is complete, so a reader can
+ * tell a complete message from one being written or already replaced.
+ */
+struct PoseSlot
+{
+    std::atomic<uint64_t> sequence;
+    PoseMessage message;
+};
+
+struct PoseRing
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t slots;
+    uint32_t slot_size;
+    uint32_t reserved;
+    std::atomic<uint64_t> head;   // messages published so far
+    char padding[32];             // keeps the slots on their own cache line
+
+    PoseSlot* slot(uint64_t n)
+    {
+        return reinterpret_cast<PoseSlot*>(this + 1) + n % slots;
+    }
+};
+
+static_assert(sizeof(PoseRing) == 64, "ring header spans one cache line");
+
+namespace {
+
+size_t ringSize(uint32_t slots)
+{
+    return sizeof(PoseRing) + static_cast<size_t>(slots) * sizeof(PoseSlot);
+}
+
+#ifndef _WIN32
+void* mapShared(const std::string& name, bool create, size_t& size)
+{
+    int fd = create ? shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644)
+                    : shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return nullptr;
+    if (create && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        // the name was created here, do not leave it behind unusable
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+    if (!create) {
+        off_t end = lseek(fd, 0, SEEK_END);
+        if (end < static_cast<off_t>(sizeof(PoseRing))) {
+            ::close(fd);
+            return nullptr;
+        }
+        size = static_cast<size_t>(end);
+    }
+    void* data = mmap(nullptr, size, create ? PROT_READ | PROT_WRITE
+                                            : PROT_READ,
+                      MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        if (create)
+            shm_unlink(name.c_str());
+        return nullptr;
+    }
+    return data;
+}
+#endif
+
+} // namespace
+
+size_t PoseMessage::usedSize() const
+{
+    return offsetof(PoseMessage, markers) +
+           std::min(count, kMaxPoseMarkers) * sizeof(PoseRecord);
+}
+
+void toPoseMessage(const Frame& frame, uint32_t camera, PoseMessage& message)
+{
+    bool has_pose = frame.rvecs.size() == frame.ids.size();
+    message.frame = frame.index;
+    message.timestamp = frame.timestamp;
+    message.publish_ns = 0;
+    message.sequence = 0;
+    message.camera = camera;
+    message.count = has_pose ? static_cast<uint32_t>(std::min<size_t>(
+                                   frame.ids.size(), kMaxPoseMarkers))
+                             : 0;
+    for (uint32_t i = 0; i < message.count; i++) {
+        PoseRecord& record = message.markers[i];
+        record.id = frame.ids[i];
+        record.flags = frame.isPredicted(i) ? kMarkerPredicted : 0;
+        for (int k = 0; k < 3; k++) {
+            record.rvec[k] = frame.rvecs[i][k];
+            record.tvec[k] = frame.tvecs[i][k];
+        }
+    }
+}
+
+uint64_t monotonicNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+PosePublisher::PosePublisher()
+    : ring_(nullptr), size_(0)
+{
+}
+
+PosePublisher::~PosePublisher()
+{
+    close();
+}
+
+bool PosePublisher::open(const std::string& name, bool replace,
+                         uint32_t slots)
+{
+    close();
+#ifdef _WIN32
+    return false;
+#else
+    CV_Assert(slots > 0);
+    if (replace)
+        shm_unlink(name.c_str());
+    size_ = ringSize(slots);
+    void* data = mapShared(name, true, size_);
+    if (!data)
+        return false;
+
+    ring_ = new (data) PoseRing;
+    ring_->version = kRingVersion;
+    ring_->slots = slots;
+    ring_->slot_size = sizeof(PoseSlot);
+    ring_->reserved = 0;
+    ring_->head.store(0, std::memory_order_relaxed);
+    for (uint32_t n = 0; n < slots; n++)
+        new (ring_->slot(n)) PoseSlot;
+    for (uint32_t n = 0; n < slots; n++)
+        ring_->slot(n)->sequence.store(0, std::memory_order_relaxed);
+    // readers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(ring_->magic, kRingMagic, sizeof(kRingMagic));
+    name_ = name;
+    return true;
+#endif
+}
+
+void PosePublisher::close()
+{
+#ifndef _WIN32
+    if (!ring_)
+        return;
+    munmap(ring_, size_);
+    shm_unlink(name_.c_str());
+    ring_ = nullptr;
+#endif
+}
+
+void PosePublisher::publish(const PoseMessage& message)
+{
+    if (!ring_)
+        return;
+    uint64_t n = ring_->head.load(std::memory_order_relaxed);
+    PoseSlot* slot = ring_->slot(n);
+    slot->sequence.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&slot->message, &message, message.usedSize());
+    slot->message.publish_ns = monotonicNanoseconds();
+    slot->message.sequence = n;
+    slot->sequence.store(2 * n + 2, std::memory_order_release);
+    ring_->head.store(n + 1, std::memory_order_release);
+}
+
+PoseSubscriber::PoseSubscriber()
+    : ring_(nullptr), size_(0), next_(0), lost_(0)
+{
+}
+
+PoseSubscriber::~PoseSubscriber()
+{
+    close();
+}
+
+bool PoseSubscriber::open(const std::string& name)
+{
+    close();
+#ifdef _WIN32
+    return false;
+#else
+    void* data = mapShared(name, false, size_);
+    if (!data)
+        return false;
+    PoseRing* ring = static_cast<PoseRing*>(data);
+    if (std::memcmp(ring->magic, kRingMagic, sizeof(kRingMagic)) != 0 ||
+        ring->version != kRingVersion ||
+        ring->slot_size != sizeof(PoseSlot) ||
+        size_ < ringSize(ring->slots)) {
+        munmap(data, size_);
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    ring_ = ring;
+    next_ = ring_->head.load(std::memory_order_acquire);
+    lost_ = 0;
+    return true;
+#endif
+}
+
+void PoseSubscriber::close()
+{
+#ifndef _WIN32
+    if (!ring_)
+        return;
+    munmap(ring_, size_);
+    ring_ = nullptr;
+#endif
+}
+
+bool PoseSubscriber::read(PoseMessage& message)
+{
+    if (!ring_)
+        return false;
+    while (true) {
+        uint64_t head = ring_->head.load(std::memory_order_acquire);
+        if (next_ >= head)
+            return false;
+        // a full ring behind, the oldest messages are already gone
+        if (head - next_ > ring_->slots) {
+            lost_ += head - ring_->slots - next_;
+            next_ = head - ring_->slots;
+        }
+
+        PoseSlot* slot = ring_->slot(next_);
+        uint64_t expected = 2 * next_ + 2;
+        uint64_t before = slot->sequence.load(std::memory_order_acquire);
+        if (before == expected) {
+            std::memcpy(&message, &slot->message,
+                        offsetof(PoseMessage, markers));
+            message.count = std::min(message.count, kMaxPoseMarkers);
+            std::memcpy(message.markers, slot->message.markers,
+                        message.count * sizeof(PoseRecord));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot->sequence.load(std::memory_order_relaxed) == before) {
+                next_++;
+                return true;
+            }
+        }
+        // replaced by a newer message while we were not looking
+        lost_++;
+        next_++;
+    }
+}
+
+bool PoseSubscriber::wait(PoseMessage& message, double timeout)
+{
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point spin_end = start + std::chrono::microseconds(50);
+    const Clock::time_point yield_end = start + std::chrono::milliseconds(1);
+    const Clock::time_point end =
+        start + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(timeout));
+    while (!read(message)) {
+        Clock::time_point now = Clock::now();
+        if (now >= end)
+            return false;
+        if (now >= yield_end)
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        else if (now >= spin_end)
+            std::this_thread::yield();
+    }
+    return true;
+}
+
+} // namespace aruco_markers
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/pose_datagram.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+
+namespace aruco_markers {
+
+namespace {
+
+#ifndef _WIN32
+/**
+ * Opens a UDP socket for host:port, bound to it when listening and
+ * connected to it otherwise. Returns -1 on failure.
+ */
+int openSocket(const std::string& address, bool listen)
+{
+    size_t colon = address.find_last_of(':');
+    if (colon == std::string::npos)
+        return -1;
+    std::string host = address.substr(0, colon);
+    std::string port = address.substr(colon + 1);
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = listen ? AI_PASSIVE : 0;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(),
+                    &hints, &found) != 0)
+        return -1;
+
+    int fd = -1;
+    for (addrinfo* a = found; a && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0)
+            continue;
+        int result = listen ? bind(fd, a->ai_addr, a->ai_addrlen)
+                            : connect(fd, a->ai_addr, a->ai_addrlen);
+        if (result != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+#endif
+
+} // namespace
+
+PoseDatagramPublisher::PoseDatagramPublisher()
+    : socket_(-1), sequence_(0)
+{
+}
+
+PoseDatagramPublisher::~PoseDatagramPublisher()
+{
+    close();
+}
+
+bool PoseDatagramPublisher::open(const std::string& address)
+{
+    close();
+#ifdef _WIN32
+    return false;
+#else
+    socket_ = openSocket(address, false);
+    return socket_ >= 0;
+#endif
+}
+
+void PoseDatagramPublisher::close()
+{
+#ifndef _WIN32
+    if (socket_ >= 0)
+        ::close(socket_);
+#endif
+    socket_ = -1;
+}
+
+void PoseDatagramPublisher::publish(const PoseMessage& message)
+{
+#ifndef _WIN32
+    if (socket_ < 0)
+        return;
+    PoseMessage stamped;
+    size_t size = message.usedSize();
+    std::memcpy(&stamped, &message, size);
+    stamped.publish_ns = monotonicNanoseconds();
+    stamped.sequence = sequence_++;
+    // a consumer that is not listening makes send fail; that is fine
+    send(socket_, &stamped, size, MSG_DONTWAIT);
+#endif
+}
+
+PoseDatagramSubscriber::PoseDatagramSubscriber()
+    : socket_(-1), started_(false), next_(0), lost_(0)
+{
+}
+
+PoseDatagramSubscriber::~PoseDatagramSubscriber()
+{
+    close();
+}
+
+bool PoseDatagramSubscriber::open(const std::string& address)
+{
+    close();
+#ifdef _WIN32
+    return false;
+#else
+    socket_ = openSocket(address, true);
+    started_ = false;
+    lost_ = 0;
+    return socket_ >= 0;
+#endif
+}
+
+void PoseDatagramSubscriber::close()
+{
+#ifndef _WIN32
+    if (socket_ >= 0)
+        ::close(socket_);
+#endif
+    socket_ = -1;
+}
+
+bool PoseDatagramSubscriber::wait(PoseMessage& message, double timeout)
+{
+#ifdef _WIN32
+    return false;
+#else
+    if (socket_ < 0)
+        return false;
+    pollfd readable;
+    readable.fd = socket_;
+    readable.events = POLLIN;
+    while (true) {
+        readable.revents = 0;
+        if (poll(&readable, 1, static_cast<int>(timeout * 1000)) <= 0)
+            return false;
+        ssize_t size = recv(socket_, &message, sizeof(message), 0);
+        if (size < static_cast<ssize_t>(offsetof(PoseMessage, markers)) ||
+            message.count > kMaxPoseMarkers ||
+            static_cast<size_t>(size) != message.usedSize())
+            continue;
+        if (started_ && message.sequence > next_)
+            lost_ += message.sequence - next_;
+        started_ = true;
+        next_ = message.sequence + 1;
+        return true;
+    }
+#endif
+}
+
+} // namespace aruco_markers
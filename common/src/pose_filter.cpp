@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/pose_filter.hpp"
+
+#include <opencv2/calib3d.hpp>
+#include <algorithm>
+#include <set>
+
+
+namespace aruco_markers {
+
+namespace {
+
+cv::Matx33d exponential(const cv::Vec3d& rotation_vector)
+{
+    cv::Matx33d rotation;
+    cv::Rodrigues(rotation_vector, rotation);
+    return rotation;
+}
+
+cv::Vec3d logarithm(const cv::Matx33d& rotation)
+{
+    cv::Vec3d rotation_vector;
+    cv::Rodrigues(rotation, rotation_vector);
+    return rotation_vector;
+}
+
+} // namespace
+
+PoseFilter::PoseFilter(double alpha, double beta, double max_age)
+    : alpha_(alpha),
+      beta_(beta),
+      max_age_(max_age)
+{
+    CV_Assert(alpha > 0 && alpha <= 1 && beta >= 0 && beta < 2 &&
+              max_age >= 0);
+}
+
+void PoseFilter::reset()
+{
+    tracks_.clear();
+}
+
+void PoseFilter::predict(const Track& track, double dt, cv::Vec3d& position,
+                         cv::Matx33d& rotation)
+{
+    position = track.position + track.velocity * dt;
+    rotation = exponential(track.angular_velocity * dt) * track.rotation;
+}
+
+void PoseFilter::filter(double timestamp, std::vector<int>& ids,
+                        std::vector<cv::Vec3d>& rvecs,
+                        std::vector<cv::Vec3d>& tvecs,
+                        std::vector<bool>* predicted)
+{
+    CV_Assert(ids.size() == rvecs.size() && ids.size() == tvecs.size());
+    size_t measured = ids.size();
+    std::set<int> seen;
+
+    for (size_t i = 0; i < measured; i++) {
+        // a second marker with the same id is passed through unfiltered
+        if (!seen.insert(ids[i]).second)
+            continue;
+
+        std::map<int, Track>::iterator found = tracks_.find(ids[i]);
+        double dt = found == tracks_.end() ? 0.0
+                                           : timestamp - found->second.time;
+        if (found == tracks_.end() || dt <= 0 || dt > max_age_) {
+            Track& track = tracks_[ids[i]];
+            track.time = timestamp;
+            track.position = tvecs[i];
+            track.velocity = cv::Vec3d();
+            track.rotation = exponential(rvecs[i]);
+            track.angular_velocity = cv::Vec3d();
+            continue;
+        }
+
+        Track& track = found->second;
+        cv::Vec3d position;
+        cv::Matx33d rotation;
+        predict(track, dt, position, rotation);
+
+        cv::Vec3d residual = tvecs[i] - position;
+        track.position = position + alpha_ * residual;
+        track.velocity += (beta_ / dt) * residual;
+
+        cv::Vec3d angular_residual = logarithm(exponential(rvecs[i]) *
+                                               rotation.t());
+        track.rotation = exponential(alpha_ * angular_residual) * rotation;
+        track.angular_velocity += (beta_ / dt) * angular_residual;
+        track.time = timestamp;
+
+        tvecs[i] = track.position;
+        rvecs[i] = logarithm(track.rotation);
+    }
+
+    std::map<int, Track>::iterator it = tracks_.begin();
+    while (it != tracks_.end()) {
+        double dt = timestamp - it->second.time;
+        if (dt > max_age_) {
+            tracks_.erase(it++);
+            continue;
+        }
+        if (seen.count(it->first) == 0) {
+            cv::Vec3d position;
+            cv::Matx33d rotation;
+            predict(it->second, dt, position, rotation);
+            ids.push_back(it->first);
+            rvecs.push_back(logarithm(rotation));
+            tvecs.push_back(position);
+        }
+        ++it;
+    }
+
+    if (predicted) {
+        predicted->assign(ids.size(), true);
+        std::fill(predicted->begin(), predicted->begin() + measured, false);
+    }
+}
+
+} // namespace aruco_markers
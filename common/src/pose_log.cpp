@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/pose_log.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <set>
+
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "aruco_markers/result_writer.hpp"
+
+
+namespace aruco_markers {
+
+namespace {
+
+const size_t kHeaderSize = 16;
+
+// record layout after the size field, see result_writer.hpp
+const size_t kFrameOffset = 4;
+const size_t kTimestampOffset = 12;
+const size_t kCountOffset = 20;
+const size_t kHasPoseOffset = 24;
+const size_t kMarkersOffset = 28;
+const size_t kCornersSize = 8 * sizeof(float);
+const size_t kPoseSize = 6 * sizeof(double);
+
+static_assert(sizeof(PoseLogEntry) == 24,
+              "index entries are mapped straight from the file");
+
+template <typename T>
+T load(const unsigned char* p)
+{
+    T value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// id, and from version 2 the flags, ahead of the corners
+size_t markerHeaderSize(uint32_t version)
+{
+    return sizeof(int32_t) + (version >= 2 ? sizeof(uint32_t) : 0);
+}
+
+size_t markerSize(bool has_pose, uint32_t version)
+{
+    return markerHeaderSize(version) + kCornersSize +
+           (has_pose ? kPoseSize : 0);
+}
+
+} // namespace
+
+/**
+ * A read-only file mapping; files are read into memory where mmap is
+ * not available.
+ */
+class PoseLogReader::MappedFile
+{
+public:
+    MappedFile() : data_(nullptr), size_(0) {}
+
+    ~MappedFile()
+    {
+#ifndef _WIN32
+        if (data_ && size_ > 0)
+            munmap(const_cast<unsigned char*>(data_), size_);
+#endif
+    }
+
+    bool open(const std::string& path)
+    {
+#ifdef _WIN32
+        std::ifstream file(path.c_str(), std::ios::binary);
+        if (!file)
+            return false;
+        buffer_.assign(std::istreambuf_iterator<char>(file),
+                       std::istreambuf_iterator<char>());
+        data_ = reinterpret_cast<const unsigned char*>(buffer_.data());
+        size_ = buffer_.size();
+        return true;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+        size_ = static_cast<size_t>(info.st_size);
+        if (size_ > 0) {
+            void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+            if (data == MAP_FAILED) {
+                ::close(fd);
+                size_ = 0;
+                return false;
+            }
+            data_ = static_cast<const unsigned char*>(data);
+        }
+        // the mapping stays valid without the descriptor
+        ::close(fd);
+        return true;
+#endif
+    }
+
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const unsigned char* data_;
+    size_t size_;
+#ifdef _WIN32
+    std::string buffer_;
+#endif
+};
+
+PoseLogReader::PoseLogReader()
+    : version_(0), entries_(nullptr), count_(0), indexed_(false)
+{
+}
+
+PoseLogReader::~PoseLogReader()
+{
+}
+
+bool PoseLogReader::open(const std::string& path)
+{
+    close();
+    log_.reset(new MappedFile);
+    if (!log_->open(path) || log_->size() < kHeaderSize ||
+        std::memcmp(log_->data(), kBinaryMagic, sizeof(kBinaryMagic)) != 0) {
+        close();
+        return false;
+    }
+    // logs written before markers had flags read as never predicted
+    version_ = load<uint32_t>(log_->data() + sizeof(kBinaryMagic));
+    if (version_ < 1 || version_ > kBinaryVersion) {
+        close();
+        return false;
+    }
+    const unsigned char* log = log_->data();
+    const uint64_t log_size = log_->size();
+
+    // trust the index up to its first entry that does not describe the
+    // next record of the log, e.g. one left by an earlier log of the name
+    size_t valid = 0;
+    uint64_t end = kHeaderSize;
+    index_.reset(new MappedFile);
+    if (index_->open(ResultWriter::indexPath(path)) &&
+        index_->size() >= kHeaderSize &&
+        std::memcmp(index_->data(), kIndexMagic, sizeof(kIndexMagic)) == 0 &&
+        load<uint32_t>(index_->data() + sizeof(kIndexMagic)) ==
+            kIndexVersion) {
+        const PoseLogEntry* indexed = reinterpret_cast<const PoseLogEntry*>(
+            index_->data() + kHeaderSize);
+        size_t entries = (index_->size() - kHeaderSize) / sizeof(PoseLogEntry);
+        for (; valid < entries; valid++) {
+            const PoseLogEntry& entry = indexed[valid];
+            // records follow each other without gaps
+            if (entry.offset != end || end + sizeof(uint32_t) > log_size)
+                break;
+            uint32_t size = load<uint32_t>(log + end);
+            if (size < kMarkersOffset - sizeof(uint32_t) ||
+                size > log_size - end - sizeof(uint32_t) ||
+                load<int64_t>(log + end + kFrameOffset) != entry.frame ||
+                load<double>(log + end + kTimestampOffset) != entry.timestamp)
+                break;
+            end += sizeof(uint32_t) + size;
+        }
+        indexed_ = valid > 0;
+        entries_ = indexed;
+        count_ = valid;
+    }
+
+    if (end < log_size) {
+        // records the index does not cover are indexed in memory
+        scanned_.assign(entries_, entries_ + valid);
+        scan(end);
+        entries_ = scanned_.data();
+        count_ = scanned_.size();
+    }
+    if (count_ == 0)
+        entries_ = nullptr;
+    return true;
+}
+
+void PoseLogReader::close()
+{
+    log_.reset();
+    index_.reset();
+    version_ = 0;
+    scanned_.clear();
+    entries_ = nullptr;
+    count_ = 0;
+    indexed_ = false;
+}
+
+void PoseLogReader::scan(uint64_t offset)
+{
+    const unsigned char* log = log_->data();
+    const uint64_t log_size = log_->size();
+    while (offset + sizeof(uint32_t) <= log_size) {
+        uint32_t size = load<uint32_t>(log + offset);
+        if (size < kMarkersOffset - sizeof(uint32_t) ||
+            offset + sizeof(uint32_t) + size > log_size)
+            break;
+        PoseLogEntry entry;
+        entry.frame = load<int64_t>(log + offset + kFrameOffset);
+        entry.timestamp = load<double>(log + offset + kTimestampOffset);
+        entry.offset = offset;
+        scanned_.push_back(entry);
+        offset += sizeof(uint32_t) + size;
+    }
+}
+
+size_t PoseLogReader::seekFrame(int64_t frame) const
+{
+    const PoseLogEntry* found = std::lower_bound(
+        entries_, entries_ + count_, frame,
+        [](const PoseLogEntry& entry, int64_t value) {
+            return entry.frame < value;
+        });
+    return found - entries_;
+}
+
+size_t PoseLogReader::seekTime(double seconds) const
+{
+    const PoseLogEntry* found = std::lower_bound(
+        entries_, entries_ + count_, seconds,
+        [](const PoseLogEntry& entry, double value) {
+            return entry.timestamp < value;
+        });
+    return found - entries_;
+}
+
+const unsigned char* PoseLogReader::record(size_t index, uint32_t& count,
+                                           bool& has_pose) const
+{
+    CV_Assert(index < count_);
+    uint64_t offset = entries_[index].offset;
+    const unsigned char* p = log_->data() + offset;
+    count = load<uint32_t>(p + kCountOffset);
+    has_pose = load<uint32_t>(p + kHasPoseOffset) != 0;
+    // a damaged count must not read past the record, nor the log
+    size_t end = static_cast<size_t>(std::min<uint64_t>(
+        sizeof(uint32_t) + load<uint32_t>(p), log_->size() - offset));
+    size_t available = end > kMarkersOffset
+                       ? (end - kMarkersOffset) / markerSize(has_pose,
+                                                             version_)
+                       : 0;
+    count = static_cast<uint32_t>(std::min<size_t>(count, available));
+    return p + kMarkersOffset;
+}
+
+void PoseLogReader::read(size_t record_index, Frame& frame) const
+{
+    uint32_t count;
+    bool has_pose;
+    const unsigned char* p = record(record_index, count, has_pose);
+    frame.index = entries_[record_index].frame;
+    frame.timestamp = entries_[record_index].timestamp;
+    frame.ids.resize(count);
+    frame.corners.resize(count);
+    frame.rvecs.resize(has_pose ? count : 0);
+    frame.tvecs.resize(has_pose ? count : 0);
+    frame.predicted.assign(count, false);
+    for (uint32_t i = 0; i < count; i++) {
+        frame.ids[i] = load<int32_t>(p);
+        if (version_ >= 2)
+            frame.predicted[i] = (load<uint32_t>(p + sizeof(int32_t)) &
+                                  kMarkerPredicted) != 0;
+        p += markerHeaderSize(version_);
+        frame.corners[i].resize(4);
+        for (int k = 0; k < 4; k++) {
+            frame.corners[i][k].x = load<float>(p);
+            frame.corners[i][k].y = load<float>(p + sizeof(float));
+            p += 2 * sizeof(float);
+        }
+        if (has_pose) {
+            for (int k = 0; k < 3; k++)
+                frame.rvecs[i][k] = load<double>(p + k * sizeof(double));
+            for (int k = 0; k < 3; k++)
+                frame.tvecs[i][k] = load<double>(p + (3 + k) * sizeof(double));
+            p += kPoseSize;
+        }
+    }
+}
+
+bool PoseLogReader::findPose(size_t record_index, int id, cv::Vec3d& rvec,
+                             cv::Vec3d& tvec) const
+{
+    uint32_t count;
+    bool has_pose;
+    const unsigned char* p = record(record_index, count, has_pose);
+    if (!has_pose)
+        return false;
+    const size_t stride = markerSize(true, version_);
+    for (uint32_t i = 0; i < count; i++, p += stride) {
+        if (load<int32_t>(p) != id)
+            continue;
+        const unsigned char* pose = p + markerHeaderSize(version_) +
+                                    kCornersSize;
+        for (int k = 0; k < 3; k++) {
+            rvec[k] = load<double>(pose + k * sizeof(double));
+            tvec[k] = load<double>(pose + (3 + k) * sizeof(double));
+        }
+        return true;
+    }
+    return false;
+}
+
+std::vector<int> PoseLogReader::ids() const
+{
+    std::set<int> seen;
+    for (size_t r = 0; r < count_; r++) {
+        uint32_t count;
+        bool has_pose;
+        const unsigned char* p = record(r, count, has_pose);
+        const size_t stride = markerSize(has_pose, version_);
+        for (uint32_t i = 0; i < count; i++, p += stride)
+            seen.insert(load<int32_t>(p));
+    }
+    return std::vector<int>(seen.begin(), seen.end());
+}
+
+} // namespace aruco_markers
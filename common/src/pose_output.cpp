@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/pose_output.hpp"
+
+#include <cerrno>
+#include <iostream>
+
+
+namespace aruco_markers {
+
+PoseOutput::PoseOutput()
+{
+}
+
+bool PoseOutput::open(const std::string& shm_name,
+                      const std::string& udp_address, bool replace,
+                      std::string& error)
+{
+    if (!shm_name.empty() && !shared_.open(shm_name, replace)) {
+        if (errno == EEXIST)
+            error = "shared memory " + shm_name + " already exists and may "
+                    "belong to a running publisher";
+        else
+            error = "failed to create shared memory: " + shm_name;
+        return false;
+    }
+    if (!udp_address.empty() && !datagrams_.open(udp_address)) {
+        shared_.close();
+        error = "failed to open udp destination: " + udp_address;
+        return false;
+    }
+    return true;
+}
+
+void PoseOutput::publish(const Frame& frame, uint32_t camera)
+{
+    if (!isOpened())
+        return;
+    toPoseMessage(frame, camera, message_);
+    if (shared_.isOpened())
+        shared_.publish(message_);
+    if (datagrams_.isOpened())
+        datagrams_.publish(message_);
+}
+
+bool openPoseOutput(const cv::CommandLineParser& parser, PoseOutput& output)
+{
+    std::string shm_name, udp_address, error;
+    if (parser.has("shm"))
+        shm_name = parser.get<cv::String>("shm");
+    if (parser.has("udp"))
+        udp_address = parser.get<cv::String>("udp");
+    if (!output.open(shm_name, udp_address, parser.get<bool>("shmforce"),
+                     error)) {
+        std::cerr << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace aruco_markers
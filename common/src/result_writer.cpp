@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "aruco_markers/result_writer.hpp"
+
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+
+namespace aruco_markers {
+
+namespace {
+
+template <typename T>
+void append(std::string& buffer, const T& value)
+{
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+} // namespace
+
+ResultWriter::ResultWriter(std::FILE* file)
+    : file_(file),
+      failed_(false)
+{
+}
+
+ResultWriter::~ResultWriter()
+{
+    if (file_ && file_ != stdout)
+        std::fclose(file_);
+    else if (file_)
+        std::fflush(file_);
+}
+
+void ResultWriter::flush()
+{
+    flushFile(file_);
+}
+
+bool ResultWriter::put(std::FILE* file, const void* data, size_t size)
+{
+    if (failed_)
+        return false;
+    if (std::fwrite(data, 1, size, file) != size)
+        fail();
+    return !failed_;
+}
+
+void ResultWriter::flushFile(std::FILE* file)
+{
+    // buffered writes may only fail here
+    if (std::fflush(file) != 0)
+        fail();
+}
+
+void ResultWriter::fail()
+{
+    if (!failed_)
+        std::cerr << "failed to write results, stopped writing"
+                  << std::endl;
+    failed_ = true;
+}
+
+cv::Ptr<ResultWriter> ResultWriter::create(const std::string& format,
+                                           const std::string& path)
+{
+    bool binary;
+    if (format == "jsonl")
+        binary = false;
+    else if (format == "bin")
+        binary = true;
+    else
+        return cv::Ptr<ResultWriter>();
+
+    std::FILE* file;
+    if (isStdoutPath(path)) {
+        file = stdout;
+#ifdef _WIN32
+        if (binary)
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    } else {
+        file = std::fopen(path.c_str(), binary ? "wb" : "w");
+        if (!file)
+            return cv::Ptr<ResultWriter>();
+    }
+
+    if (binary) {
+        std::FILE* index_file = nullptr;
+        if (file != stdout) {
+            index_file = std::fopen(indexPath(path).c_str(), "wb");
+            if (!index_file) {
+                std::fclose(file);
+                return cv::Ptr<ResultWriter>();
+            }
+        }
+        return cv::makePtr<BinaryResultWriter>(file, index_file);
+    }
+    return cv::makePtr<JsonlResultWriter>(file);
+}
+
+std::string ResultWriter::indexPath(const std::string& path)
+{
+    return path + ".idx";
+}
+
+JsonlResultWriter::JsonlResultWriter(std::FILE* file)
+    : ResultWriter(file)
+{
+}
+
+void JsonlResultWriter::write(const Frame& frame)
+{
+    bool has_pose = frame.rvecs.size() == frame.ids.size() &&
+                    !frame.ids.empty();
+
+    std::fprintf(file_, "{\"frame\":%lld,\"t\":%.6f,\"markers\":[",
+                 static_cast<long long>(frame.index), frame.timestamp);
+    for (size_t i = 0; i < frame.ids.size(); i++) {
+        const std::vector<cv::Point2f>& c = frame.corners[i];
+        std::fprintf(file_,
+                     "%s{\"id\":%d,\"corners\":[[%.3f,%.3f],[%.3f,%.3f],"
+                     "[%.3f,%.3f],[%.3f,%.3f]]",
+                     i ? "," : "", frame.ids[i], c[0].x, c[0].y, c[1].x,
+                     c[1].y, c[2].x, c[2].y, c[3].x, c[3].y);
+        if (frame.isPredicted(i))
+            std::fputs(",\"predicted\":true", file_);
+        if (has_pose) {
+            const cv::Vec3d& r = frame.rvecs[i];
+            const cv::Vec3d& t = frame.tvecs[i];
+            std::fprintf(file_,
+                         ",\"rvec\":[%.6f,%.6f,%.6f],"
+                         "\"tvec\":[%.6f,%.6f,%.6f]",
+                         r[0], r[1], r[2], t[0], t[1], t[2]);
+        }
+        std::fputc('}', file_);
+    }
+    std::fputs("]}\n", file_);
+}
+
+BinaryResultWriter::BinaryResultWriter(std::FILE* file,
+                                       std::FILE* index_file)
+    : ResultWriter(file),
+      index_file_(index_file)
+{
+    uint32_t reserved = 0;
+    put(file_, kBinaryMagic, sizeof(kBinaryMagic));
+    put(file_, &kBinaryVersion, sizeof(kBinaryVersion));
+    put(file_, &reserved, sizeof(reserved));
+    offset_ = sizeof(kBinaryMagic) + sizeof(kBinaryVersion) +
+              sizeof(reserved);
+
+    if (index_file_) {
+        put(index_file_, kIndexMagic, sizeof(kIndexMagic));
+        put(index_file_, &kIndexVersion, sizeof(kIndexVersion));
+        put(index_file_, &reserved, sizeof(reserved));
+    }
+}
+
+BinaryResultWriter::~BinaryResultWriter()
+{
+    if (index_file_)
+        std::fclose(index_file_);
+}
+
+void BinaryResultWriter::flush()
+{
+    // the log first, so the index never points past what is on disk
+    ResultWriter::flush();
+    if (index_file_)
+        flushFile(index_file_);
+}
+
+void BinaryResultWriter::write(const Frame& frame)
+{
+    uint32_t count = static_cast<uint32_t>(frame.ids.size());
+    uint32_t has_pose = frame.rvecs.size() == frame.ids.size() && count > 0;
+
+    buffer_.clear();
+    append(buffer_, uint32_t(0));
+    append(buffer_, static_cast<int64_t>(frame.index));
+    append(buffer_, frame.timestamp);
+    append(buffer_, count);
+    append(buffer_, has_pose);
+    for (size_t i = 0; i < count; i++) {
+        append(buffer_, static_cast<int32_t>(frame.ids[i]));
+        append(buffer_, frame.isPredicted(i) ? kMarkerPredicted : 0u);
+        for (int k = 0; k < 4; k++) {
+            append(buffer_, frame.corners[i][k].x);
+            append(buffer_, frame.corners[i][k].y);
+        }
+        if (has_pose) {
+            for (int k = 0; k < 3; k++)
+                append(buffer_, frame.rvecs[i][k]);
+            for (int k = 0; k < 3; k++)
+                append(buffer_, frame.tvecs[i][k]);
+        }
+    }
+
+    uint32_t size = static_cast<uint32_t>(buffer_.size() - sizeof(uint32_t));
+    std::memcpy(&buffer_[0], &size, sizeof(size));
+    // no index entry for a record that did not reach the log
+    if (!put(file_, buffer_.data(), buffer_.size()))
+        return;
+
+    if (index_file_) {
+        int64_t index = frame.index;
+        put(index_file_, &index, sizeof(index));
+        put(index_file_, &frame.timestamp, sizeof(frame.timestamp));
+        put(index_file_, &offset_, sizeof(offset_));
+    }
+    offset_ += buffer_.size();
+}
+
+bool isStdoutPath(const std::string& path)
+{
+    return path.empty() || path == "-";
+}
+
+} // namespace aruco_markers
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "aruco_markers/roi_tracker.hpp"
+
+#include <algorithm>
+
+
+namespace aruco_markers {
+
+namespace {
+
+// smallest margin around a predicted marker, in pixels
+const float kMinPadding = 8.0f;
+
+cv::Rect predictRegion(const std::vector<cv::Point2f>& corners,
+                       const cv::Point2f& velocity, float padding)
+{
+    float min_x = corners[0].x, max_x = corners[0].x;
+    float min_y = corners[0].y, max_y = corners[0].y;
+    for (size_t i = 1; i < corners.size(); i++) {
+        min_x = std::min(min_x, corners[i].x);
+        max_x = std::max(max_x, corners[i].x);
+        min_y = std::min(min_y, corners[i].y);
+        max_y = std::max(max_y, corners[i].y);
+    }
+
+    float margin = std::max(kMinPadding,
+                            padding * std::max(max_x - min_x, max_y - min_y));
+    min_x += velocity.x - margin;
+    max_x += velocity.x + margin;
+    min_y += velocity.y - margin;
+    max_y += velocity.y + margin;
+
+    return cv::Rect(cv::Point(cvFloor(min_x), cvFloor(min_y)),
+                    cv::Point(cvCeil(max_x) + 1, cvCeil(max_y) + 1));
+}
+
+// Merges intersecting rectangles until all of them are disjoint.
+void mergeRegions(std::vector<cv::Rect>& regions)
+{
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < regions.size() && !merged; i++) {
+            for (size_t j = i + 1; j < regions.size(); j++) {
+                if ((regions[i] & regions[j]).area() > 0) {
+                    regions[i] |= regions[j];
+                    regions.erase(regions.begin() + j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+RoiTracker::RoiTracker(const DetectFunction& detect, int rescan_interval,
+                       float padding)
+    : detect_(detect),
+      rescan_interval_(std::max(1, rescan_interval)),
+      padding_(padding),
+      frames_since_scan_(0),
+      full_scan_(false)
+{
+}
+
+void RoiTracker::reset()
+{
+    tracks_.clear();
+    frames_since_scan_ = 0;
+}
+
+void RoiTracker::detect(const cv::Mat& image, MarkerCorners& corners,
+                        std::vector<int>& ids)
+{
+    full_scan_ = tracks_.empty() || frames_since_scan_ >= rescan_interval_ ||
+                 !detectInRegions(image, corners, ids);
+    if (full_scan_)
+        detectFull(image, corners, ids);
+    else
+        frames_since_scan_++;
+
+    updateTracks(corners, ids);
+}
+
+void RoiTracker::detectFull(const cv::Mat& image, MarkerCorners& corners,
+                            std::vector<int>& ids)
+{
+    detect_(image, corners, ids);
+    frames_since_scan_ = 0;
+}
+
+bool RoiTracker::detectInRegions(const cv::Mat& image, MarkerCorners& corners,
+                                 std::vector<int>& ids)
+{
+    cv::Rect bounds(0, 0, image.cols, image.rows);
+
+    regions_.clear();
+    for (size_t i = 0; i < tracks_.size(); i++) {
+        cv::Rect region = predictRegion(tracks_[i].corners,
+                                        tracks_[i].velocity, padding_) &
+                          bounds;
+        if (region.area() > 0)
+            regions_.push_back(region);
+    }
+    mergeRegions(regions_);
+
+    corners.clear();
+    ids.clear();
+    for (size_t r = 0; r < regions_.size(); r++) {
+        const cv::Rect& region = regions_[r];
+        detect_(image(region), region_corners_, region_ids_);
+
+        cv::Point2f offset(static_cast<float>(region.x),
+                           static_cast<float>(region.y));
+        for (size_t i = 0; i < region_ids_.size(); i++) {
+            if (std::find(ids.begin(), ids.end(), region_ids_[i]) != ids.end())
+                continue;
+            for (size_t k = 0; k < region_corners_[i].size(); k++)
+                region_corners_[i][k] += offset;
+            corners.push_back(region_corners_[i]);
+            ids.push_back(region_ids_[i]);
+        }
+    }
+
+    // every tracked marker has to be found again, otherwise rescan
+    for (size_t i = 0; i < tracks_.size(); i++) {
+        if (std::find(ids.begin(), ids.end(), tracks_[i].id) == ids.end())
+            return false;
+    }
+    return true;
+}
+
+void RoiTracker::updateTracks(const MarkerCorners& corners,
+                              const std::vector<int>& ids)
+{
+    std::vector<Track> tracks;
+    tracks.reserve(ids.size());
+    for (size_t i = 0; i < ids.size(); i++) {
+        Track track;
+        track.id = ids[i];
+        track.corners = corners[i];
+        track.velocity = cv::Point2f(0, 0);
+
+        for (size_t j = 0; j < tracks_.size(); j++) {
+            if (tracks_[j].id != ids[i])
+                continue;
+            for (size_t k = 0; k < corners[i].size(); k++)
+                track.velocity += corners[i][k] - tracks_[j].corners[k];
+            track.velocity *= 1.0f / corners[i].size();
+            break;
+        }
+        tracks.push_back(track);
+    }
+    tracks_.swap(tracks);
+}
+
+} // namespace aruco_markers
@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/stats.hpp"
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+
+
+namespace aruco_markers {
+
+namespace {
+
+std::atomic<uint64_t> next_stats_id(1);
+
+int bucketIndex(int64_t ns)
+{
+    if (ns <= 1000)
+        return 0;
+    int index = static_cast<int>(std::ceil(4.0 * std::log2(ns / 1000.0)));
+    return std::min(index, Stats::kBuckets - 1);
+}
+
+// Upper bound of a bucket in seconds.
+double bucketBound(int index)
+{
+    return std::pow(2.0, index / 4.0) * 1e-6;
+}
+
+template <typename Histogram>
+double percentile(const Histogram& counts, uint64_t total, double p)
+{
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(
+        std::ceil(p * total)));
+    uint64_t cumulative = 0;
+    for (int i = 0; i < Stats::kBuckets; i++) {
+        cumulative += counts[i];
+        if (cumulative >= target)
+            return bucketBound(i);
+    }
+    return bucketBound(Stats::kBuckets - 1);
+}
+
+} // namespace
+
+Stats::Stats()
+    : id_(next_stats_id++),
+      enabled_(false),
+      epoch_(Clock::now()),
+      trace_next_(0),
+      summary_stream_(nullptr),
+      reporting_(false)
+{
+}
+
+Stats::~Stats()
+{
+    stopReporting();
+}
+
+int Stats::addStage(const std::string& name)
+{
+    CV_Assert(static_cast<int>(stages_.size()) < kMaxStages);
+    stages_.push_back(name);
+    return static_cast<int>(stages_.size()) - 1;
+}
+
+void Stats::enable()
+{
+    enabled_ = true;
+}
+
+bool Stats::enableTrace(const std::string& path, size_t max_events)
+{
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+    std::fclose(file);
+
+    trace_path_ = path;
+    trace_.resize(max_events);
+    trace_next_ = 0;
+    enabled_ = true;
+    return true;
+}
+
+Stats::ThreadSlot& Stats::threadSlot()
+{
+    // a thread may record into several Stats and keeps a slot in each;
+    // ids are never reused, so entries of destroyed ones are never matched
+    static thread_local std::vector<std::pair<uint64_t, ThreadSlot*> > owned;
+    for (size_t i = 0; i < owned.size(); i++)
+        if (owned[i].first == id_)
+            return *owned[i].second;
+
+    std::unique_ptr<ThreadSlot> created(new ThreadSlot);
+    for (int s = 0; s < kMaxStages; s++) {
+        for (int b = 0; b < kBuckets; b++)
+            created->counts[s][b].store(0, std::memory_order_relaxed);
+        created->sum_ns[s].store(0, std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    created->tid = static_cast<int>(slots_.size()) + 1;
+    slots_.push_back(std::move(created));
+    owned.push_back(std::make_pair(id_, slots_.back().get()));
+    return *owned.back().second;
+}
+
+void Stats::add(ThreadSlot& slot, int stage, int64_t ns)
+{
+    // a single writer per slot, readers only need eventual totals
+    slot.counts[stage][bucketIndex(ns)].fetch_add(1,
+                                                  std::memory_order_relaxed);
+    slot.sum_ns[stage].fetch_add(static_cast<uint64_t>(std::max<int64_t>(
+        ns, 0)), std::memory_order_relaxed);
+}
+
+void Stats::record(int stage, Clock::time_point start, Clock::time_point end)
+{
+    ThreadSlot& slot = threadSlot();
+    int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        end - start).count();
+    add(slot, stage, ns);
+
+    if (trace_.empty())
+        return;
+    size_t next = trace_next_.fetch_add(1, std::memory_order_relaxed);
+    if (next >= trace_.size())
+        return;
+    TraceEvent& event = trace_[next];
+    event.stage = stage;
+    event.tid = slot.tid;
+    event.start_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        start - epoch_).count();
+    event.duration_us = ns / 1000;
+}
+
+void Stats::record(int stage, double seconds)
+{
+    add(threadSlot(), stage, static_cast<int64_t>(seconds * 1e9));
+}
+
+void Stats::startReporting(double interval, std::ostream* summary,
+                           const std::string& prometheus_path)
+{
+    CV_Assert(interval > 0 && !reporter_.joinable());
+    summary_stream_ = summary;
+    prometheus_path_ = prometheus_path;
+    reporting_ = true;
+    reporter_ = std::thread(&Stats::reportLoop, this, interval);
+}
+
+void Stats::stopReporting()
+{
+    if (reporter_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(report_mutex_);
+            reporting_ = false;
+        }
+        report_cv_.notify_all();
+        reporter_.join();
+        report();
+        summary_stream_ = nullptr;
+        prometheus_path_.clear();
+    }
+
+    if (!trace_path_.empty()) {
+        if (!writeTrace())
+            std::fprintf(stderr, "failed to write trace: %s\n",
+                         trace_path_.c_str());
+        trace_path_.clear();
+    }
+}
+
+void Stats::reportLoop(double interval)
+{
+    std::unique_lock<std::mutex> lock(report_mutex_);
+    while (!report_cv_.wait_for(lock, std::chrono::duration<double>(interval),
+                                [this] { return !reporting_; })) {
+        lock.unlock();
+        report();
+        lock.lock();
+    }
+}
+
+void Stats::report()
+{
+    if (!prometheus_path_.empty() && !writePrometheus(prometheus_path_))
+        std::fprintf(stderr, "failed to write stats: %s\n",
+                     prometheus_path_.c_str());
+    if (summary_stream_)
+        *summary_stream_ << summary() << std::endl;
+}
+
+void Stats::merge(std::vector<Histogram>& counts,
+                  std::vector<uint64_t>& sum_ns) const
+{
+    counts.assign(stages_.size(), Histogram());
+    sum_ns.assign(stages_.size(), 0);
+    for (size_t s = 0; s < stages_.size(); s++)
+        counts[s].fill(0);
+
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    for (size_t t = 0; t < slots_.size(); t++) {
+        const ThreadSlot& slot = *slots_[t];
+        for (size_t s = 0; s < stages_.size(); s++) {
+            for (int b = 0; b < kBuckets; b++)
+                counts[s][b] += slot.counts[s][b].load(
+                    std::memory_order_relaxed);
+            sum_ns[s] += slot.sum_ns[s].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+std::string Stats::summary() const
+{
+    std::vector<Histogram> counts;
+    std::vector<uint64_t> sum_ns;
+    merge(counts, sum_ns);
+
+    double uptime = std::chrono::duration<double>(Clock::now() -
+                                                  epoch_).count();
+    std::string line = cv::format("stats %.1f s (p50/p99 ms)", uptime);
+    for (size_t s = 0; s < stages_.size(); s++) {
+        uint64_t total = 0;
+        for (int b = 0; b < kBuckets; b++)
+            total += counts[s][b];
+        if (total == 0)
+            continue;
+        line += cv::format(" | %s %.2f/%.2f", stages_[s].c_str(),
+                           percentile(counts[s], total, 0.50) * 1e3,
+                           percentile(counts[s], total, 0.99) * 1e3);
+    }
+    return line;
+}
+
+bool Stats::writePrometheus(const std::string& path) const
+{
+    std::vector<Histogram> counts;
+    std::vector<uint64_t> sum_ns;
+    merge(counts, sum_ns);
+
+    // write aside and rename so scrapers never see a partial file
+    std::string temporary = path + ".tmp";
+    std::FILE* file = std::fopen(temporary.c_str(), "w");
+    if (!file)
+        return false;
+
+    std::fprintf(file, "# HELP aruco_stage_seconds Duration of each "
+                       "processing stage.\n"
+                       "# TYPE aruco_stage_seconds histogram\n");
+    for (size_t s = 0; s < stages_.size(); s++) {
+        const char* name = stages_[s].c_str();
+        uint64_t cumulative = 0;
+        for (int b = 0; b < kBuckets; b++) {
+            cumulative += counts[s][b];
+            // one bucket per octave keeps the file small
+            if (b % 4 == 0)
+                std::fprintf(file, "aruco_stage_seconds_bucket{stage=\"%s\","
+                             "le=\"%g\"} %llu\n", name, bucketBound(b),
+                             static_cast<unsigned long long>(cumulative));
+        }
+        std::fprintf(file, "aruco_stage_seconds_bucket{stage=\"%s\","
+                     "le=\"+Inf\"} %llu\n", name,
+                     static_cast<unsigned long long>(cumulative));
+        std::fprintf(file, "aruco_stage_seconds_sum{stage=\"%s\"} %.9f\n",
+                     name, sum_ns[s] * 1e-9);
+        std::fprintf(file, "aruco_stage_seconds_count{stage=\"%s\"} %llu\n",
+                     name, static_cast<unsigned long long>(cumulative));
+    }
+
+    bool ok = std::fclose(file) == 0;
+    if (ok && std::rename(temporary.c_str(), path.c_str()) != 0) {
+        // rename does not replace an existing file on Windows
+        std::remove(path.c_str());
+        ok = std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+    return ok;
+}
+
+bool Stats::writeTrace() const
+{
+    std::FILE* file = std::fopen(trace_path_.c_str(), "w");
+    if (!file)
+        return false;
+
+    size_t count = std::min(trace_next_.load(), trace_.size());
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (size_t i = 0; i < count; i++) {
+        const TraceEvent& event = trace_[i];
+        std::fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                     "\"tid\":%d,\"ts\":%lld,\"dur\":%lld}", i ? "," : "",
+                     stages_[event.stage].c_str(), event.tid,
+                     static_cast<long long>(event.start_us),
+                     static_cast<long long>(event.duration_us));
+    }
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
+
+} // namespace aruco_markers
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "aruco_markers/thread_pool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+
+namespace aruco_markers {
+
+namespace {
+
+// pool and worker index of the calling thread, if it is a pool worker
+thread_local const void* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t threads)
+    : next_worker_(0),
+      pending_(0),
+      stopping_(false)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t i = 0; i < threads; i++)
+        workers_.push_back(std::unique_ptr<Worker>(new Worker));
+    for (size_t i = 0; i < threads; i++)
+        threads_.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    available_.notify_all();
+    for (size_t i = 0; i < threads_.size(); i++)
+        threads_[i].join();
+}
+
+void ThreadPool::submit(Task task)
+{
+    size_t index = current_pool == this
+                 ? current_worker
+                 : next_worker_++ % workers_.size();
+    // count the task before it can be taken, a worker that takes it right
+    // away would otherwise decrement pending_ below zero
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+        workers_[index]->tasks.push_back(std::move(task));
+    }
+    available_.notify_one();
+}
+
+bool ThreadPool::takeTask(size_t index, Task& task)
+{
+    {
+        Worker& own = *workers_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < workers_.size(); i++) {
+        Worker& victim = *workers_[(index + i) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t index)
+{
+    current_pool = this;
+    current_worker = index;
+
+    Task task;
+    for (;;) {
+        if (takeTask(index, task)) {
+            pending_--;
+            task();
+            task = Task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (pending_ > 0)
+            continue;
+        if (stopping_)
+            break;
+        available_.wait(lock, [this] { return pending_ > 0 || stopping_; });
+    }
+}
+
+} // namespace aruco_markers
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/threshold.hpp"
+
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cstdint>
+
+
+namespace aruco_markers {
+
+namespace {
+
+/**
+ * Thresholds one row. Box sums are taken from the integral rows above and
+ * below the window in unsigned arithmetic: the integral of a large frame
+ * can wrap around 32 bits, the difference of four entries never does.
+ */
+void thresholdRow(const uint8_t* src, const int32_t* top,
+                  const int32_t* bottom, int left, int right, int width,
+                  int area, int delta, uint8_t* dst)
+{
+    const uint32_t* t = reinterpret_cast<const uint32_t*>(top);
+    const uint32_t* b = reinterpret_cast<const uint32_t*>(bottom);
+    int x = 0;
+
+#if CV_SIMD
+    const int lanes = cv::v_int32::nlanes;
+    const cv::v_float32 v_inv_area = cv::vx_setall_f32(1.0f / area);
+    const cv::v_int32 v_delta = cv::vx_setall_s32(delta);
+    for (; x <= width - cv::v_uint8::nlanes; x += cv::v_uint8::nlanes) {
+        cv::v_uint16 s0, s1;
+        cv::v_expand(cv::vx_load(src + x), s0, s1);
+        cv::v_uint32 s[4];
+        cv::v_expand(s0, s[0], s[1]);
+        cv::v_expand(s1, s[2], s[3]);
+
+        cv::v_int32 foreground[4];
+        for (int k = 0; k < 4; k++) {
+            int i = x + k * lanes;
+            cv::v_uint32 sum = cv::vx_load(b + i + right) -
+                               cv::vx_load(b + i + left) -
+                               cv::vx_load(t + i + right) +
+                               cv::vx_load(t + i + left);
+            cv::v_int32 mean = cv::v_round(cv::v_cvt_f32(
+                cv::v_reinterpret_as_s32(sum)) * v_inv_area);
+            // all ones where the pixel is brighter than mean - constant
+            foreground[k] = cv::v_reinterpret_as_s32(s[k]) + v_delta > mean;
+        }
+        cv::v_int8 bright = cv::v_pack(cv::v_pack(foreground[0], foreground[1]),
+                                       cv::v_pack(foreground[2], foreground[3]));
+        cv::v_store(dst + x, ~cv::v_reinterpret_as_u8(bright));
+    }
+    cv::vx_cleanup();
+#endif
+
+    float inv_area = 1.0f / area;
+    for (; x < width; x++) {
+        uint32_t sum = b[x + right] - b[x + left] - t[x + right] + t[x + left];
+        int mean = cvRound(static_cast<int32_t>(sum) * inv_area);
+        dst[x] = src[x] + delta > mean ? 0 : 255;
+    }
+}
+
+} // namespace
+
+std::vector<int> thresholdWindowSizes(
+    const cv::aruco::DetectorParameters& params)
+{
+    std::vector<int> sizes;
+    if (params.adaptiveThreshWinSizeMin < 3 ||
+        params.adaptiveThreshWinSizeMax < params.adaptiveThreshWinSizeMin ||
+        params.adaptiveThreshWinSizeStep <= 0)
+        return sizes;
+
+    int count = (params.adaptiveThreshWinSizeMax -
+                 params.adaptiveThreshWinSizeMin) /
+                params.adaptiveThreshWinSizeStep + 1;
+    for (int i = 0; i < count; i++) {
+        int size = params.adaptiveThreshWinSizeMin +
+                   i * params.adaptiveThreshWinSizeStep;
+        if (size % 2 == 0)
+            size++;
+        sizes.push_back(size);
+    }
+    return sizes;
+}
+
+void thresholdWindows(const cv::Mat& gray, const std::vector<int>& window_sizes,
+                      double constant, std::vector<cv::Mat>& binaries)
+{
+    CV_Assert(gray.type() == CV_8UC1);
+    binaries.resize(window_sizes.size());
+    if (window_sizes.empty() || gray.empty())
+        return;
+
+    int radius = 0;
+    for (size_t i = 0; i < window_sizes.size(); i++) {
+        CV_Assert(window_sizes[i] >= 3 && window_sizes[i] % 2 == 1);
+        radius = std::max(radius, window_sizes[i] / 2);
+        binaries[i].create(gray.size(), CV_8UC1);
+    }
+
+    // one padding for the largest window serves every smaller one
+    cv::Mat padded, integral;
+    cv::copyMakeBorder(gray, padded, radius, radius, radius, radius,
+                       cv::BORDER_REPLICATE);
+    cv::integral(padded, integral, CV_32S);
+
+    // adaptiveThreshold keeps pixels with src - mean > -floor(constant)
+    int delta = cvFloor(constant);
+    int stripe_rows = 64;
+    int stripes = (gray.rows + stripe_rows - 1) / stripe_rows;
+    int jobs = static_cast<int>(window_sizes.size()) * stripes;
+
+    cv::parallel_for_(cv::Range(0, jobs), [&](const cv::Range& range) {
+        for (int job = range.start; job < range.end; job++) {
+            int w = job / stripes;
+            int half = window_sizes[w] / 2;
+            int area = window_sizes[w] * window_sizes[w];
+            int left = radius - half;
+            int right = radius + half + 1;
+            cv::Mat& binary = binaries[w];
+
+            int y_end = std::min(gray.rows, (job % stripes + 1) * stripe_rows);
+            for (int y = (job % stripes) * stripe_rows; y < y_end; y++) {
+                thresholdRow(gray.ptr<uint8_t>(y),
+                             integral.ptr<int32_t>(y + radius - half),
+                             integral.ptr<int32_t>(y + radius + half + 1),
+                             left, right, gray.cols, area, delta,
+                             binary.ptr<uint8_t>(y));
+            }
+        }
+    });
+}
+
+} // namespace aruco_markers
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/video_recorder.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <opencv2/imgproc.hpp>
+
+
+namespace aruco_markers {
+
+VideoRecorder::VideoRecorder(size_t queue_capacity, Policy policy)
+    : policy_(policy),
+      color_(true),
+      queue_(queue_capacity),
+      // one buffer being encoded and one being filled besides the queue
+      buffers_(queue_.capacity() + 2),
+      written_(0),
+      dropped_(0)
+{
+}
+
+VideoRecorder::~VideoRecorder()
+{
+    close();
+}
+
+bool VideoRecorder::open(const std::string& path, const std::string& codec,
+                         double fps, cv::Size frame_size, bool color)
+{
+    CV_Assert(!isOpened());
+    std::string fourcc = codec.empty() ? defaultCodec(path) : codec;
+    if (fourcc.size() != 4 || fps <= 0 || frame_size.area() == 0)
+        return false;
+    int code = cv::VideoWriter::fourcc(fourcc[0], fourcc[1], fourcc[2],
+                                       fourcc[3]);
+    if (!writer_.open(path, code, fps, frame_size, color))
+        return false;
+    color_ = color;
+    thread_ = std::thread(&VideoRecorder::encodeLoop, this);
+    return true;
+}
+
+bool VideoRecorder::write(const cv::Mat& frame)
+{
+    if (!isOpened())
+        return false;
+    // gray frames of a color recording are expanded in the same pass
+    if (color_ && frame.channels() == 1) {
+        cv::Mat copy = buffers_.acquire(frame.size(), CV_8UC3);
+        cv::cvtColor(frame, copy, cv::COLOR_GRAY2BGR);
+        return enqueue(copy);
+    }
+    cv::Mat copy = buffers_.acquire(frame.size(), frame.type());
+    frame.copyTo(copy);
+    return enqueue(copy);
+}
+
+bool VideoRecorder::enqueue(const cv::Mat& copy)
+{
+    if (policy_ == BLOCK)
+        return queue_.push(copy);
+    bool dropped;
+    if (!queue_.pushDroppingOldest(copy, dropped))
+        return false;
+    if (dropped)
+        dropped_++;
+    return true;
+}
+
+void VideoRecorder::close()
+{
+    if (!isOpened())
+        return;
+    queue_.close();
+    thread_.join();
+    writer_.release();
+}
+
+void VideoRecorder::encodeLoop()
+{
+    cv::Mat frame;
+    while (queue_.pop(frame)) {
+        writer_.write(frame);
+        frame.release();
+        written_++;
+    }
+}
+
+std::string VideoRecorder::defaultCodec(const std::string& path)
+{
+    size_t dot = path.find_last_of('.');
+    std::string extension = dot == std::string::npos ? std::string()
+                                                      : path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    if (extension == "mp4" || extension == "mov")
+        return "mp4v";
+    return "MJPG";
+}
+
+bool readRecorderOptions(const cv::CommandLineParser& parser,
+                         RecorderOptions& options)
+{
+    options = RecorderOptions();
+    if (parser.has("rec"))
+        options.path = parser.get<cv::String>("rec");
+    if (parser.has("codec"))
+        options.codec = parser.get<cv::String>("codec");
+    options.fps = parser.get<double>("recfps");
+
+    cv::String policy = parser.get<cv::String>("recpolicy");
+    if (policy != "drop" && policy != "block") {
+        std::cerr << "recording policy must be drop or block" << std::endl;
+        return false;
+    }
+    // the encoder runs on its own thread, by default dropping frames
+    // rather than holding up the output stage when it falls behind
+    options.policy = policy == "block" ? VideoRecorder::BLOCK
+                                       : VideoRecorder::DROP_OLDEST;
+
+    int queue_capacity = parser.get<int>("recqueue");
+    if (queue_capacity < 1) {
+        std::cerr << "recording queue must hold at least one frame"
+                  << std::endl;
+        return false;
+    }
+    options.queue_capacity = static_cast<size_t>(queue_capacity);
+    return true;
+}
+
+bool openRecorder(const RecorderOptions& options, double source_fps,
+                  cv::Size frame_size, VideoRecorder& recorder)
+{
+    if (options.path.empty())
+        return true;
+    double fps = options.fps > 0 ? options.fps : source_fps;
+    if (fps <= 0)
+        fps = 30;
+    if (!recorder.open(options.path, options.codec, fps, frame_size)) {
+        std::cerr << "failed to open recording: " << options.path
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace aruco_markers
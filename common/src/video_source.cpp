@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "aruco_markers/video_source.hpp"
+
+#include <cstdlib>
+
+
+namespace aruco_markers {
+
+SourceKind sourceKind(const cv::String& source)
+{
+    char* end = nullptr;
+    std::strtol(source.c_str(), &end, 10);
+    if (end && end != source.c_str() && *end == '\0')
+        return CAMERA_SOURCE;
+    if (source.find("://") != cv::String::npos &&
+        source.compare(0, 7, "file://") != 0)
+        return STREAM_SOURCE;
+    return FILE_SOURCE;
+}
+
+SourceKind openSource(cv::VideoCapture& capture, const cv::String& source)
+{
+    SourceKind kind = sourceKind(source);
+    if (kind == CAMERA_SOURCE)
+        capture.open(static_cast<int>(std::strtol(source.c_str(), nullptr,
+                                                  10)));
+    else
+        capture.open(source);
+    return kind;
+}
+
+} // namespace aruco_markers
@@ -39,13 +39,16 @@ the use of this software, even if advised of the possibility of such damage.
 
 #include <opencv2/highgui.hpp>
 #include <opencv2/aruco.hpp>
+#include <iostream>
+
+#include "aruco_markers/marker_sheet.hpp"
 
 using namespace cv;
 
 namespace {
 const char* about = "Create an ArUco grid board image";
 const char* keys  =
-        "{@outfile |<none> | Output image }"
+        "{@outfile |<none> | Output image, or .svg or .pdf vector file with all lengths in mm }"
         "{w        |       | Number of markers in X direction }"
         "{h        |       | Number of markers in Y direction }"
         "{l        |       | Marker side length (in pixels) }"
@@ -99,6 +102,32 @@ int main(int argc, char *argv[]) {
     Ptr<aruco::GridBoard> board = aruco::GridBoard::create(markersX, markersY, float(markerLength),
                                                       float(markerSeparation), dictionary);
 
+    String extension = out.size() > 4 ? out.substr(out.size() - 4) : String();
+    if(extension == ".svg" || extension == ".pdf") {
+        // the board is one sheet whose page fits the grid exactly
+        aruco_markers::SheetLayout layout;
+        layout.page_width = imageSize.width;
+        layout.page_height = imageSize.height;
+        layout.margin = margins;
+        layout.marker_length = markerLength;
+        layout.gap = markerSeparation;
+        layout.border_bits = borderBits;
+        layout.labels = false;
+        aruco_markers::MarkerSheets sheet(dictionary, board->ids, layout);
+
+        if(showImage) {
+            imshow("board", sheet.raster(0, 25.4));
+            waitKey(0);
+        }
+
+        bool written = extension == ".svg" ? sheet.writeSvg(out) : sheet.writePdf(out);
+        if(!written) {
+            std::cerr << "Failed to write " << out << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
     // show created board
     Mat boardImage;
     board->draw(imageSize, boardImage, margins, borderBits);
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include <opencv2/highgui.hpp>
+#include <opencv2/aruco.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "aruco_markers/marker_sheet.hpp"
+
+using namespace cv;
+using namespace std;
+
+namespace {
+const char* about =
+        "Create print sheets of ArUco markers\n"
+        "  Lays out a range of marker ids, by default the whole dictionary,\n"
+        "  on as many pages as needed. The output format follows the file\n"
+        "  extension: .svg writes one vector file per page, .pdf one\n"
+        "  multi-page vector document, anything else one raster image per\n"
+        "  page. Pages are numbered as sheet_001.svg, sheet_002.svg, ...\n";
+const char* keys  =
+        "{@outfile |<none> | Output file }"
+        "{d        |       | dictionary: DICT_4X4_50=0, DICT_4X4_100=1, DICT_4X4_250=2,"
+        "DICT_4X4_1000=3, DICT_5X5_50=4, DICT_5X5_100=5, DICT_5X5_250=6, DICT_5X5_1000=7, "
+        "DICT_6X6_50=8, DICT_6X6_100=9, DICT_6X6_250=10, DICT_6X6_1000=11, DICT_7X7_50=12,"
+        "DICT_7X7_100=13, DICT_7X7_250=14, DICT_7X7_1000=15, DICT_ARUCO_ORIGINAL = 16}"
+        "{first    | 0     | First marker id }"
+        "{last     | -1    | Last marker id, -1 for the last of the dictionary }"
+        "{page     | a4    | Page size: a4, a3, letter or <width>x<height> in mm }"
+        "{ml       | 40    | Marker side length in mm }"
+        "{gap      | 10    | Space between markers in mm }"
+        "{m        | 10    | Page margins in mm }"
+        "{bb       | 1     | Number of bits in marker borders }"
+        "{nl       | false | Do not print the marker ids below the markers }"
+        "{dpi      | 300   | Resolution of raster pages }"
+        "{bench    | false | Report the throughput, and that of drawing and encoding each marker with cv::aruco::drawMarker }";
+}
+
+/**
+ */
+static bool parsePage(const string& page, double& width, double& height) {
+    if(page == "a4") {
+        width = 210;
+        height = 297;
+    } else if(page == "a3") {
+        width = 297;
+        height = 420;
+    } else if(page == "letter") {
+        width = 215.9;
+        height = 279.4;
+    } else if(sscanf(page.c_str(), "%lfx%lf", &width, &height) != 2) {
+        return false;
+    }
+    return width > 0 && height > 0;
+}
+
+/**
+ */
+static bool hasExtension(const string& name, const string& extension) {
+    return name.size() > extension.size() &&
+           name.compare(name.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    CommandLineParser parser(argc, argv, keys);
+    parser.about(about);
+
+    if(argc < 3) {
+        parser.printMessage();
+        return 0;
+    }
+
+    int dictionaryId = parser.get<int>("d");
+    int firstId = parser.get<int>("first");
+    int lastId = parser.get<int>("last");
+    string page = parser.get<string>("page");
+    double dpi = parser.get<double>("dpi");
+    bool bench = parser.get<bool>("bench");
+
+    aruco_markers::SheetLayout layout;
+    layout.marker_length = parser.get<double>("ml");
+    layout.gap = parser.get<double>("gap");
+    layout.margin = parser.get<double>("m");
+    layout.border_bits = parser.get<int>("bb");
+    layout.labels = !parser.get<bool>("nl");
+
+    String out = parser.get<String>(0);
+
+    if(!parser.check()) {
+        parser.printErrors();
+        return 0;
+    }
+
+    if(!parsePage(page, layout.page_width, layout.page_height)) {
+        cerr << "Invalid page size " << page << endl;
+        return 1;
+    }
+
+    Ptr<aruco::Dictionary> dictionary =
+        aruco::getPredefinedDictionary(aruco::PREDEFINED_DICTIONARY_NAME(dictionaryId));
+
+    if(lastId < 0) lastId = dictionary->bytesList.rows - 1;
+    if(firstId < 0 || lastId >= dictionary->bytesList.rows || firstId > lastId) {
+        cerr << "Marker ids must lie within 0 and " << dictionary->bytesList.rows - 1 << endl;
+        return 1;
+    }
+    vector<int> ids;
+    for(int id = firstId; id <= lastId; id++) ids.push_back(id);
+
+    TickMeter layoutTime;
+    layoutTime.start();
+    aruco_markers::MarkerSheets sheets(dictionary, ids, layout);
+    layoutTime.stop();
+
+    if(sheets.markersPerPage() == 0) {
+        cerr << "Markers of " << layout.marker_length << " mm do not fit on the page" << endl;
+        return 1;
+    }
+
+    TickMeter writeTime;
+    writeTime.start();
+    bool written;
+    if(hasExtension(out, ".svg")) {
+        written = sheets.writeSvg(out);
+    } else if(hasExtension(out, ".pdf")) {
+        written = sheets.writePdf(out);
+    } else {
+        written = sheets.writeRaster(out, dpi);
+    }
+    writeTime.stop();
+
+    if(!written) {
+        cerr << "Failed to write " << out << endl;
+        return 1;
+    }
+
+    cout << ids.size() << " markers on " << sheets.pages() << " pages of "
+         << sheets.columns() << "x" << sheets.rows() << endl;
+
+    if(bench) {
+        double total = layoutTime.getTimeSec() + writeTime.getTimeSec();
+        cout << "sheets:      " << layoutTime.getTimeMilli() << " ms layout, "
+             << writeTime.getTimeMilli() << " ms render and write, "
+             << ids.size() / total << " markers/s, "
+             << sheets.pages() / total << " pages/s" << endl;
+
+        // what generate_marker does for every id, minus the process start
+        int markerPixels = cvRound(layout.marker_length * dpi / 25.4);
+        TickMeter singleTime;
+        singleTime.start();
+        Mat markerImg;
+        vector<uchar> encoded;
+        for(size_t i = 0; i < ids.size(); i++) {
+            aruco::drawMarker(dictionary, ids[i], markerPixels, markerImg, layout.border_bits);
+            imencode(".png", markerImg, encoded);
+        }
+        singleTime.stop();
+        cout << "drawMarker:  " << singleTime.getTimeMilli() << " ms, "
+             << ids.size() / singleTime.getTimeSec() << " markers/s" << endl;
+    }
+
+    return 0;
+}
@@ -23,9 +23,19 @@
 
 #include <opencv2/opencv.hpp>
 #include <opencv2/aruco.hpp>
+#include <algorithm>
 #include <iostream>
 #include <cstdlib>
 
+#include "aruco_markers/detection.hpp"
+#include "aruco_markers/detector_tuner.hpp"
+#include "aruco_markers/luma_capture.hpp"
+#include "aruco_markers/overlay.hpp"
+#include "aruco_markers/pipeline.hpp"
+#include "aruco_markers/result_writer.hpp"
+#include "aruco_markers/stats.hpp"
+#include "aruco_markers/video_source.hpp"
+
 
 namespace {
 const char* about = "Detect ArUco marker images";
@@ -36,7 +46,33 @@ const char* keys  =
         "DICT_6X6_250=10, DICT_6X6_1000=11, DICT_7X7_50=12, DICT_7X7_100=13, "
         "DICT_7X7_250=14, DICT_7X7_1000=15, DICT_ARUCO_ORIGINAL = 16}"
         "{h        |false | Print help }"
+        "{dp       |<none>| File of marker detector parameters }"
+        "{tune     |0     | Narrow threshold windows and perimeter limits to "
+        "the markers found, searching with the full parameters every N frames "
+        "and after a miss; 0 disables }"
         "{v        |<none>| Custom video source, otherwise '0' }"
+        "{dec      |1     | Detection decimation: search markers at 1/N "
+        "resolution, refine corners at full resolution }"
+        "{tiles    |1     | Split frames into NxN overlapping tiles that are "
+        "searched in parallel }"
+        "{overlap  |128   | Tile overlap in pixels, at least the largest "
+        "marker size }"
+        "{headless |false | Process as fast as possible without a display }"
+        "{gray     |false | Capture only the luma plane (GREY, YUYV or NV12 "
+        "from cameras that offer it) and detect on it; frames are turned "
+        "into color only for drawing }"
+        "{o        |<none>| Write per-frame results to this file, '-' for "
+        "stdout (default when headless) }"
+        "{fmt      |jsonl | Result format: jsonl or bin }"
+        "{j        |1     | Frames processed in parallel when reading a file, "
+        "0 for all cores }"
+        "{stats    |false | Print stage latency percentiles every --interval "
+        "seconds }"
+        "{prom     |<none>| Write stage latency histograms to this Prometheus "
+        "text file every --interval seconds }"
+        "{interval |5     | Seconds between stats reports }"
+        "{trace    |<none>| Write the first stage timings to this Chrome trace "
+        "file }"
         ;
 }
 
@@ -52,22 +88,57 @@ int main(int argc, char **argv)
 
     int dictionaryId = parser.get<int>("d");
     int wait_time = 10;
+    int decimation = parser.get<int>("dec");
+    int tiles = parser.get<int>("tiles");
+    int tile_overlap = parser.get<int>("overlap");
+    int workers = parser.get<int>("j");
+    bool headless = parser.get<bool>("headless");
+    bool gray = parser.get<bool>("gray");
+    cv::String results_path = parser.has("o") ? parser.get<cv::String>("o")
+                                              : cv::String("-");
+    cv::String results_format = parser.get<cv::String>("fmt");
+    bool print_stats = parser.get<bool>("stats");
+    double stats_interval = parser.get<double>("interval");
+
+    if (decimation < 1) {
+        std::cerr << "decimation factor must be at least 1" << std::endl;
+        return 1;
+    }
+
+    if (tiles < 1 || tile_overlap < 0) {
+        std::cerr << "tiles must be at least 1 and the overlap must not be "
+                     "negative" << std::endl;
+        return 1;
+    }
+
+    if (workers < 0) {
+        std::cerr << "number of parallel frames must not be negative"
+                  << std::endl;
+        return 1;
+    }
+
+    if (stats_interval <= 0) {
+        std::cerr << "stats interval must be positive" << std::endl;
+        return 1;
+    }
+
+    int tune_interval = 0;
+    cv::Ptr<cv::aruco::DetectorParameters> detector_params;
+    if (!aruco_markers::readDetectorOptions(parser, detector_params,
+                                            tune_interval))
+        return 1;
+
+
     cv::String videoInput = "0";
     cv::VideoCapture in_video;
+    aruco_markers::SourceKind source_kind = aruco_markers::CAMERA_SOURCE;
     if (parser.has("v")) {
         videoInput = parser.get<cv::String>("v");
         if (videoInput.empty()) {
             parser.printMessage();
             return 1;
         }
-        char* end = nullptr;
-        int source = static_cast<int>(std::strtol(videoInput.c_str(), &end, \
-            10));
-        if (!end || end == videoInput.c_str()) {
-            in_video.open(videoInput); // url
-        } else {
-            in_video.open(source); // id
-        }
+        source_kind = aruco_markers::openSource(in_video, videoInput);
     } else {
         in_video.open(0);
     }
@@ -82,29 +153,132 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    // detection needs one channel, skip the BGR decode where possible
+    aruco_markers::LumaCapture luma(in_video);
+    if (gray)
+        std::cerr << "capturing "
+                  << aruco_markers::LumaCapture::formatName(luma.configure())
+                  << " frames as gray" << std::endl;
+
+    cv::Ptr<aruco_markers::ResultWriter> results;
+    if (headless || parser.has("o")) {
+        results = aruco_markers::ResultWriter::create(results_format,
+                                                      results_path);
+        if (!results) {
+            std::cerr << "failed to open " << results_format
+                      << " result output: " << results_path << std::endl;
+            return 1;
+        }
+    }
+
     cv::Ptr<cv::aruco::Dictionary> dictionary =
         cv::aruco::getPredefinedDictionary( \
         cv::aruco::PREDEFINED_DICTIONARY_NAME(dictionaryId));
+    aruco_markers::MarkerDetector detector(dictionary, detector_params);
+    detector.setDecimation(decimation);
+    detector.setTiling(tiles, tile_overlap);
+    cv::Ptr<aruco_markers::DetectorAutoTuner> tuner;
+    if (tune_interval > 0)
+        tuner = cv::makePtr<aruco_markers::DetectorAutoTuner>(detector,
+                                                              tune_interval);
+
+    // keep stdout clean when it carries the per-frame results
+    std::ostream& info = results && aruco_markers::isStdoutPath(results_path)
+                       ? std::cerr : std::cout;
+
+    aruco_markers::Stats stats;
+    const int grab_stage = stats.addStage("grab");
+    const int retrieve_stage = stats.addStage("retrieve");
+    const int detect_stage = stats.addStage("detect");
+    const int copy_stage = stats.addStage("copy");
+    const int draw_stage = stats.addStage("draw");
+    const int show_stage = stats.addStage("show");
+
+    if (print_stats || parser.has("prom")) {
+        stats.enable();
+        stats.startReporting(stats_interval, print_stats ? &info : nullptr,
+                             parser.has("prom") ? parser.get<cv::String>("prom")
+                                                : cv::String());
+    }
+    if (parser.has("trace") &&
+        !stats.enableTrace(parser.get<cv::String>("trace"))) {
+        std::cerr << "failed to open trace output: "
+                  << parser.get<cv::String>("trace") << std::endl;
+        return 1;
+    }
+
+    aruco_markers::Pipeline pipeline;
+
+    // frames of a file are independent, a camera is processed in order
+    if (source_kind != aruco_markers::CAMERA_SOURCE)
+        pipeline.setWorkers(workers);
 
-    while (in_video.grab()) {
-        cv::Mat image, image_copy;
-        in_video.retrieve(image);
-        image.copyTo(image_copy);
-        std::vector<int> ids;
-        std::vector<std::vector<cv::Point2f>> corners;
-        cv::aruco::detectMarkers(image, dictionary, corners, ids);
-        
-        // If at least one marker detected
-        if (ids.size() > 0)
-            cv::aruco::drawDetectedMarkers(image_copy, corners, ids);
-
-        imshow("Detected markers", image_copy);
+    pipeline.setCapture([&](cv::Mat& image) {
+        aruco_markers::StageTimer grab_timer(stats, grab_stage);
+        if (!in_video.grab())
+            return false;
+        grab_timer.stop();
+        aruco_markers::StageTimer retrieve_timer(stats, retrieve_stage);
+        return gray ? luma.retrieve(image) : in_video.retrieve(image);
+    });
+
+    pipeline.setDetection([&](aruco_markers::Frame& frame) {
+        aruco_markers::StageTimer timer(stats, detect_stage);
+        if (tuner)
+            tuner->detect(detector, frame.image, frame.corners, frame.ids);
+        else
+            detector.detect(frame.image, frame.corners, frame.ids);
+    });
+
+    // reused overlay buffer, headless runs never touch it
+    cv::Mat image_copy;
+    int64_t frame_count = 0;
+    pipeline.setOutput([&](aruco_markers::Frame& frame) {
+        frame_count++;
+        if (results)
+            results->write(frame);
+        if (headless)
+            return true;
+
+        // If at least one marker detected, draw on a copy of the frame
+        cv::Mat shown = frame.image;
+        if (frame.ids.size() > 0) {
+            aruco_markers::StageTimer copy_timer(stats, copy_stage);
+            aruco_markers::copyToCanvas(frame.image, image_copy);
+            copy_timer.stop();
+            aruco_markers::StageTimer draw_timer(stats, draw_stage);
+            cv::aruco::drawDetectedMarkers(image_copy, frame.corners,
+                                           frame.ids);
+            shown = image_copy;
+        }
+
+        aruco_markers::StageTimer show_timer(stats, show_stage);
+        imshow("Detected markers", shown);
         char key = (char)cv::waitKey(wait_time);
-        if (key == 27)
-            break;
+        return key != 27;
+    });
+
+    int64_t start_ticks = cv::getTickCount();
+    pipeline.run();
+    stats.stopReporting();
+
+    if (headless) {
+        double seconds = (cv::getTickCount() - start_ticks) /
+                         cv::getTickFrequency();
+        std::cerr << "processed " << frame_count << " frames in " << seconds
+                  << " s (" << frame_count / seconds << " fps)" << std::endl;
     }
 
+    if (tuner)
+        tuner->report(std::cerr);
+
     in_video.release();
 
+    // a failed write is reported by the writer, fail the run as well
+    if (results) {
+        results->flush();
+        if (results->failed())
+            return 1;
+    }
     return 0;
 }
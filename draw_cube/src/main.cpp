@@ -21,6 +21,7 @@
  *
  */
 
+#include <algorithm>
 #include <iostream>
 #include <opencv2/aruco.hpp>
 #include <opencv2/core.hpp>
@@ -29,6 +30,18 @@
 #include <iostream>
 #include <cstdlib>
 
+#include "aruco_markers/calibration.hpp"
+#include "aruco_markers/detection.hpp"
+#include "aruco_markers/detector_tuner.hpp"
+#include "aruco_markers/luma_capture.hpp"
+#include "aruco_markers/overlay.hpp"
+#include "aruco_markers/pipeline.hpp"
+#include "aruco_markers/pose.hpp"
+#include "aruco_markers/pose_filter.hpp"
+#include "aruco_markers/pose_output.hpp"
+#include "aruco_markers/video_recorder.hpp"
+#include "aruco_markers/video_source.hpp"
+
 
 namespace {
 const char* about = "Draw cube on ArUco marker images";
@@ -39,17 +52,50 @@ const char* keys  =
         "DICT_6X6_250=10, DICT_6X6_1000=11, DICT_7X7_50=12, DICT_7X7_100=13, "
         "DICT_7X7_250=14, DICT_7X7_1000=15, DICT_ARUCO_ORIGINAL = 16}"
         "{h        |false | Print help }"
+        "{dp       |<none>| File of marker detector parameters }"
+        "{tune     |0     | Narrow threshold windows and perimeter limits to "
+        "the markers found, searching with the full parameters every N frames "
+        "and after a miss; 0 disables }"
         "{l        |      | Actual marker length in meter }"
         "{v        |<none>| Custom video source, otherwise '0' }"
+        "{calib    |calibration_params.yml| Camera calibration or profile "
+        "file, scaled to the capture resolution }"
+        "{res      |<none>| Capture resolution requested from the camera, "
+        "e.g. 320x240 }"
+        "{dec      |1     | Detection decimation: search markers at 1/N "
+        "resolution, refine corners at full resolution }"
+        "{undistort|false | Undistort frames and corners with cached tables, "
+        "pose and overlays then run without distortion }"
+        "{tiles    |1     | Split frames into NxN overlapping tiles that are "
+        "searched in parallel }"
+        "{overlap  |128   | Tile overlap in pixels, at least the largest "
+        "marker size }"
+        "{filter   |false | Smooth poses per marker id and predict markers "
+        "that are missed for up to half a second }"
+        "{every    |1     | Detect markers only on every Nth frame and predict "
+        "the poses in between, implies --filter }"
+        "{gray     |false | Capture only the luma plane (GREY, YUYV or NV12 "
+        "from cameras that offer it) and detect on it; frames are turned "
+        "into color only for drawing }"
+        "{overlay  |true  | Draw markers, cubes and the position of the first "
+        "marker on the shown frames }"
+        "{rec      |<none>| Record the shown frames to this video file }"
+        "{codec    |<none>| FourCC of the recording codec, e.g. MJPG, XVID or "
+        "mp4v; chosen from the file extension by default }"
+        "{recfps   |0     | Frame rate of the recording, 0 for that of the "
+        "source }"
+        "{recqueue |8     | Frames queued for the recording encoder }"
+        "{recpolicy|drop  | When the encoder falls behind: drop the oldest "
+        "queued frame, or block until it catches up }"
+        "{shm      |<none>| Publish the poses of every frame to this shared "
+        "memory ring, e.g. /aruco_poses, for pose_subscriber }"
+        "{udp      |<none>| Publish the poses of every frame as datagrams to "
+        "host:port }"
+        "{shmforce |false | Replace an existing shared memory ring of the "
+        "same name, e.g. one left behind by a crashed publisher }"
         ;
 }
 
-void drawCubeWireframe(
-    cv::InputOutputArray image, cv::InputArray cameraMatrix,
-    cv::InputArray distCoeffs, cv::InputArray rvec, cv::InputArray tvec,
-    float l
-);
-
 
 int main(int argc, char **argv)
 {
@@ -69,6 +115,14 @@ int main(int argc, char **argv)
     int dictionaryId = parser.get<int>("d");
     float marker_length_m = parser.get<float>("l");
     int wait_time = 10;
+    int decimation = parser.get<int>("dec");
+    bool undistort = parser.get<bool>("undistort");
+    int tiles = parser.get<int>("tiles");
+    int tile_overlap = parser.get<int>("overlap");
+    int detect_every = parser.get<int>("every");
+    bool filter_poses = parser.get<bool>("filter") || detect_every > 1;
+    bool show_overlay = parser.get<bool>("overlay");
+    bool gray = parser.get<bool>("gray");
 
     if (marker_length_m <= 0) {
         std::cerr << "marker length must be a positive value in meter" 
@@ -76,22 +130,52 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    if (decimation < 1) {
+        std::cerr << "decimation factor must be at least 1" << std::endl;
+        return 1;
+    }
+
+    if (tiles < 1 || tile_overlap < 0) {
+        std::cerr << "tiles must be at least 1 and the overlap must not be "
+                     "negative" << std::endl;
+        return 1;
+    }
+
+    if (detect_every < 1) {
+        std::cerr << "detection interval must be at least 1" << std::endl;
+        return 1;
+    }
+
+    int tune_interval = 0;
+    cv::Ptr<cv::aruco::DetectorParameters> detector_params;
+    if (!aruco_markers::readDetectorOptions(parser, detector_params,
+                                            tune_interval))
+        return 1;
+
+
+    aruco_markers::RecorderOptions record_options;
+    if (!aruco_markers::readRecorderOptions(parser, record_options))
+        return 1;
+
+    cv::Size resolution;
+    if (parser.has("res") &&
+        !aruco_markers::parseResolution(parser.get<cv::String>("res"),
+                                        resolution)) {
+        std::cerr << "resolution must be given as <width>x<height>"
+                  << std::endl;
+        return 1;
+    }
+
     cv::String videoInput = "0";
     cv::VideoCapture in_video;
+    aruco_markers::SourceKind source_kind = aruco_markers::CAMERA_SOURCE;
     if (parser.has("v")) {
         videoInput = parser.get<cv::String>("v");
         if (videoInput.empty()) {
             parser.printMessage();
             return 1;
         }
-        char* end = nullptr;
-        int source = static_cast<int>(std::strtol(videoInput.c_str(), &end, \
-            10));
-        if (!end || end == videoInput.c_str()) {
-            in_video.open(videoInput); // url
-        } else {
-            in_video.open(source); // id
-        }
+        source_kind = aruco_markers::openSource(in_video, videoInput);
     } else {
         in_video.open(0);
     }
@@ -105,145 +189,168 @@ int main(int argc, char **argv)
         std::cerr << "failed to open video input: " << videoInput << std::endl;
         return 1;
     }
+    aruco_markers::setResolution(in_video, resolution);
+
+    // detection needs one channel, skip the BGR decode where possible
+    aruco_markers::LumaCapture luma(in_video);
+    if (gray)
+        std::cout << "capturing "
+                  << aruco_markers::LumaCapture::formatName(luma.configure())
+                  << " frames as gray" << std::endl;
 
-    cv::Mat image, image_copy;
     cv::Mat camera_matrix, dist_coeffs;
-    std::ostringstream vector_to_marker;
 
     cv::Ptr<cv::aruco::Dictionary> dictionary =
         cv::aruco::getPredefinedDictionary( \
         cv::aruco::PREDEFINED_DICTIONARY_NAME(dictionaryId));
-
-    cv::FileStorage fs("calibration_params.yml", cv::FileStorage::READ);
-
-    fs["camera_matrix"] >> camera_matrix;
-    fs["distortion_coefficients"] >> dist_coeffs;
+    aruco_markers::MarkerDetector detector(dictionary, detector_params);
+    detector.setDecimation(decimation);
+    detector.setTiling(tiles, tile_overlap);
+    cv::Ptr<aruco_markers::DetectorAutoTuner> tuner;
+    if (tune_interval > 0)
+        tuner = cv::makePtr<aruco_markers::DetectorAutoTuner>(detector,
+                                                              tune_interval);
+
+    // the calibration profile for the resolution frames arrive in, which
+    // the capture format chosen above may have changed
+    cv::Size frame_size = aruco_markers::setResolution(in_video, cv::Size());
+    const std::string calibration_path = parser.get<cv::String>("calib");
+    if (!aruco_markers::loadIntrinsics(calibration_path, frame_size,
+                                       camera_matrix, dist_coeffs))
+        return 1;
 
     std::cout << "camera_matrix\n"
               << camera_matrix << std::endl;
     std::cout << "\ndist coeffs\n"
               << dist_coeffs << std::endl;
 
-    int frame_width = in_video.get(cv::CAP_PROP_FRAME_WIDTH);
-    int frame_height = in_video.get(cv::CAP_PROP_FRAME_HEIGHT);
-    int fps = 30;
+    // Rectify corners through the cached lookup table; pose and overlays
+    // then work on an ideal pinhole camera without distortion.
+    aruco_markers::UndistortionCache undistortion;
+    if (undistort) {
+        if (!undistortion.load(calibration_path, camera_matrix, dist_coeffs,
+                               frame_size)) {
+            std::cerr << "failed to prepare undistortion for " << frame_size
+                      << std::endl;
+            return 1;
+        }
+        camera_matrix = undistortion.cameraMatrix();
+        dist_coeffs = cv::Mat();
+    }
 
-#if WRITE_VIDEO_OUT
-    cv::VideoWriter video(
-        "out.avi", cv::CAP_PROP_FOURCC, fps,
-        cv::Size(frame_width, frame_height), true
-    );
-#endif
+    // frames arrive in order, keep ambiguous cube poses from flipping
+    aruco_markers::SquarePoseSolver pose_solver(marker_length_m,
+                                                camera_matrix, dist_coeffs);
+    pose_solver.setWarmStart(true);
+    aruco_markers::PoseOverlay overlay(aruco_markers::PoseOverlay::CUBE,
+                                       marker_length_m, camera_matrix,
+                                       dist_coeffs);
+    // a recording is filtered on its own time line, however fast it is
+    // read; a stream drops frames like a camera, so it uses the clock
+    aruco_markers::PoseFilter pose_filter;
+    double file_fps = source_kind == aruco_markers::FILE_SOURCE
+                          ? in_video.get(cv::CAP_PROP_FPS) : 0.0;
+
+    aruco_markers::Pipeline pipeline;
+
+    aruco_markers::VideoRecorder recorder(record_options.queue_capacity,
+                                          record_options.policy);
+    if (!aruco_markers::openRecorder(record_options,
+                                     in_video.get(cv::CAP_PROP_FPS),
+                                     frame_size, recorder))
+        return 1;
+
+    // local consumers read the poses without going through a socket
+    aruco_markers::PoseOutput pose_output;
+    if (!aruco_markers::openPoseOutput(parser, pose_output))
+        return 1;
 
-    while (in_video.grab())
-    {
+    bool size_mismatch = false;
+    pipeline.setCapture([&](cv::Mat& image) {
+        if (!in_video.grab())
+            return false;
+        if (!(gray ? luma.retrieve(image) : in_video.retrieve(image)))
+            return false;
+        // the tables were built for the size the capture reported
+        if (undistort &&
+            !aruco_markers::checkFrameSize(image, undistortion.size())) {
+            size_mismatch = true;
+            return false;
+        }
+        return true;
+    });
+
+    pipeline.setDetection([&](aruco_markers::Frame& frame) {
+        if (frame.index % detect_every != 0)
+            return;
+        if (tuner)
+            tuner->detect(detector, frame.image, frame.corners, frame.ids);
+        else
+            detector.detect(frame.image, frame.corners, frame.ids);
+    });
+
+    pipeline.setPose([&](aruco_markers::Frame& frame) {
+        if (undistort && frame.ids.size() > 0)
+            undistortion.rectify(frame.corners, frame.corners);
+        // frames skipped by --every keep the warm start of the last detection
+        if (!frame.corners.empty())
+            pose_solver.solve(frame.corners, frame.ids, frame.rvecs,
+                              frame.tvecs);
+        if (filter_poses) {
+            double time = file_fps > 0 ? frame.index / file_fps
+                                       : frame.timestamp;
+            pose_filter.filter(time, frame.ids, frame.rvecs, frame.tvecs,
+                               &frame.predicted);
+            // predicted markers get the corners of their predicted pose
+            for (size_t i = frame.corners.size(); i < frame.ids.size(); i++)
+                frame.corners.push_back(aruco_markers::projectMarkerCorners(
+                    marker_length_m, camera_matrix, dist_coeffs,
+                    frame.rvecs[i], frame.tvecs[i]));
+        }
+    });
 
-        in_video.retrieve(image);
-        image.copyTo(image_copy);
-        std::vector<int> ids;
-        std::vector<std::vector<cv::Point2f>> corners;
-        cv::aruco::detectMarkers(image, dictionary, corners, ids);
+    // reused overlay buffer, only written when there is something to draw
+    cv::Mat image_copy;
+    pipeline.setOutput([&](aruco_markers::Frame& frame) {
+        // publish before drawing, consumers should not wait for the display
+        pose_output.publish(frame);
 
-        // if at least one marker detected
-        if (ids.size() > 0)
+        bool draw = show_overlay && frame.ids.size() > 0;
+
+        // if at least one marker detected, draw on a copy of the frame
+        cv::Mat shown = frame.image;
+        if (undistort)
+        {
+            undistortion.undistortImage(frame.image, image_copy);
+            shown = image_copy;
+        }
+        if (draw)
         {
-            cv::aruco::drawDetectedMarkers(image_copy, corners, ids);
-            std::vector<cv::Vec3d> rvecs, tvecs;
-            cv::aruco::estimatePoseSingleMarkers(
-                corners, marker_length_m, camera_matrix, dist_coeffs,
-                rvecs, tvecs
-            );
-
-            // draw axis for each marker
-            for (int i = 0; i < ids.size(); i++)
-            {
-                drawCubeWireframe(
-                    image_copy, camera_matrix, dist_coeffs, rvecs[i], tvecs[i],
-                    marker_length_m
-                );
-
-                // This section is going to print the data for all the detected
-                // markers. If you have more than a single marker, it is 
-                // recommended to change the below section so that either you
-                // only print the data for a specific marker, or you print the
-                // data for each marker separately.
-                vector_to_marker.str(std::string());
-                vector_to_marker << std::setprecision(4)
-                                 << "x: " << std::setw(8) << tvecs[0](0);
-                cv::putText(image_copy, vector_to_marker.str(),
-                            cv::Point(10, 30), cv::FONT_HERSHEY_SIMPLEX, 0.6,
-                            cv::Scalar(0, 252, 124), 1, cv::LINE_AA);
-
-                vector_to_marker.str(std::string());
-                vector_to_marker << std::setprecision(4)
-                                 << "y: " << std::setw(8) << tvecs[0](1);
-                cv::putText(image_copy, vector_to_marker.str(),
-                            cv::Point(10, 50), cv::FONT_HERSHEY_SIMPLEX, 0.6,
-                            cv::Scalar(0, 252, 124), 1, cv::LINE_AA);
-
-                vector_to_marker.str(std::string());
-                vector_to_marker << std::setprecision(4)
-                                 << "z: " << std::setw(8) << tvecs[0](2);
-                cv::putText(image_copy, vector_to_marker.str(),
-                            cv::Point(10, 70), cv::FONT_HERSHEY_SIMPLEX, 0.6,
-                            cv::Scalar(0, 252, 124), 1, cv::LINE_AA);
-            }
+            aruco_markers::copyToCanvas(undistort ? image_copy : frame.image,
+                                        image_copy);
+            shown = image_copy;
+            overlay.draw(image_copy, frame.corners, frame.ids, frame.rvecs,
+                         frame.tvecs);
         }
-#if WRITE_VIDEO_OUT
-        video.write(image_copy);
-#endif
-        cv::imshow("Pose estimation", image_copy);
+        if (recorder.isOpened())
+            recorder.write(shown);
+        cv::imshow("Pose estimation", shown);
         char key = (char)cv::waitKey(wait_time);
-        if (key == 27)
-            break;
-    }
+        return key != 27;
+    });
 
-    in_video.release();
+    pipeline.run();
 
-    return 0;
-}
+    if (recorder.isOpened()) {
+        recorder.close();
+        std::cout << "recorded " << recorder.written() << " frames, dropped "
+                  << recorder.dropped() << std::endl;
+    }
 
-void drawCubeWireframe(
-    cv::InputOutputArray image, cv::InputArray cameraMatrix,
-    cv::InputArray distCoeffs, cv::InputArray rvec, cv::InputArray tvec,
-    float l
-)
-{
+    if (tuner)
+        tuner->report(std::cout);
+
+    in_video.release();
 
-    CV_Assert(
-        image.getMat().total() != 0 &&
-        (image.getMat().channels() == 1 || image.getMat().channels() == 3)
-    );
-    CV_Assert(l > 0);
-    float half_l = l / 2.0;
-
-    // project cube points
-    std::vector<cv::Point3f> axisPoints;
-    axisPoints.push_back(cv::Point3f(half_l, half_l, l));
-    axisPoints.push_back(cv::Point3f(half_l, -half_l, l));
-    axisPoints.push_back(cv::Point3f(-half_l, -half_l, l));
-    axisPoints.push_back(cv::Point3f(-half_l, half_l, l));
-    axisPoints.push_back(cv::Point3f(half_l, half_l, 0));
-    axisPoints.push_back(cv::Point3f(half_l, -half_l, 0));
-    axisPoints.push_back(cv::Point3f(-half_l, -half_l, 0));
-    axisPoints.push_back(cv::Point3f(-half_l, half_l, 0));
-
-    std::vector<cv::Point2f> imagePoints;
-    projectPoints(
-        axisPoints, rvec, tvec, cameraMatrix, distCoeffs, imagePoints
-    );
-
-    // draw cube edges lines
-    cv::line(image, imagePoints[0], imagePoints[1], cv::Scalar(255, 0, 0), 3);
-    cv::line(image, imagePoints[0], imagePoints[3], cv::Scalar(255, 0, 0), 3);
-    cv::line(image, imagePoints[0], imagePoints[4], cv::Scalar(255, 0, 0), 3);
-    cv::line(image, imagePoints[1], imagePoints[2], cv::Scalar(255, 0, 0), 3);
-    cv::line(image, imagePoints[1], imagePoints[5], cv::Scalar(255, 0, 0), 3);
-    cv::line(image, imagePoints[2], imagePoints[3], cv::Scalar(255, 0, 0), 3);
-    cv::line(image, imagePoints[2], imagePoints[6], cv::Scalar(255, 0, 0), 3);
-    cv::line(image, imagePoints[3], imagePoints[7], cv::Scalar(255, 0, 0), 3);
-    cv::line(image, imagePoints[4], imagePoints[5], cv::Scalar(255, 0, 0), 3);
-    cv::line(image, imagePoints[4], imagePoints[7], cv::Scalar(255, 0, 0), 3);
-    cv::line(image, imagePoints[5], imagePoints[6], cv::Scalar(255, 0, 0), 3);
-    cv::line(image, imagePoints[6], imagePoints[7], cv::Scalar(255, 0, 0), 3);
+    return size_mismatch ? 1 : 0;
 }
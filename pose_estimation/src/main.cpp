@@ -23,8 +23,26 @@
 
 #include <opencv2/opencv.hpp>
 #include <opencv2/aruco.hpp>
+#include <algorithm>
 #include <iostream>
 #include <cstdlib>
+#include <sstream>
+
+#include "aruco_markers/calibration.hpp"
+#include "aruco_markers/detection.hpp"
+#include "aruco_markers/detector_tuner.hpp"
+#include "aruco_markers/luma_capture.hpp"
+#include "aruco_markers/multi_pipeline.hpp"
+#include "aruco_markers/overlay.hpp"
+#include "aruco_markers/pipeline.hpp"
+#include "aruco_markers/pose.hpp"
+#include "aruco_markers/pose_filter.hpp"
+#include "aruco_markers/pose_output.hpp"
+#include "aruco_markers/result_writer.hpp"
+#include "aruco_markers/roi_tracker.hpp"
+#include "aruco_markers/stats.hpp"
+#include "aruco_markers/video_recorder.hpp"
+#include "aruco_markers/video_source.hpp"
 
 
 namespace {
@@ -36,12 +54,263 @@ const char* keys  =
         "DICT_6X6_250=10, DICT_6X6_1000=11, DICT_7X7_50=12, DICT_7X7_100=13, "
         "DICT_7X7_250=14, DICT_7X7_1000=15, DICT_ARUCO_ORIGINAL = 16}"
         "{h        |false | Print help }"
+        "{dp       |<none>| File of marker detector parameters }"
+        "{tune     |0     | Narrow threshold windows and perimeter limits to "
+        "the markers found, searching with the full parameters every N frames "
+        "and after a miss; 0 disables }"
         "{l        |      | Actual marker length in meter }"
-        "{v        |<none>| Custom video source, otherwise '0' }"
-        "{h        |false | Print help }"
-        "{l        |      | Actual marker length in meter }"
-        "{v        |<none>| Custom video source, otherwise '0' }"
+        "{v        |<none>| Custom video source, otherwise '0'; a comma "
+        "separated list runs several cameras in one process }"
+        "{calib    |calibration_params.yml| Camera calibration or profile "
+        "file, scaled to the capture resolution; with several sources a "
+        "comma separated list with one file per source }"
+        "{res      |<none>| Capture resolution requested from the cameras, "
+        "e.g. 320x240 }"
+        "{sync     |20    | With several sources, largest difference in ms "
+        "between the capture times of frames output together }"
+        "{dec      |1     | Detection decimation: search markers at 1/N "
+        "resolution, refine corners at full resolution }"
+        "{undistort|false | Undistort frames and corners with cached tables, "
+        "pose and overlays then run without distortion }"
+        "{tiles    |1     | Split frames into NxN overlapping tiles that are "
+        "searched in parallel }"
+        "{overlap  |128   | Tile overlap in pixels, at least the largest "
+        "marker size }"
+        "{headless |false | Process as fast as possible without a display }"
+        "{gray     |false | Capture only the luma plane (GREY, YUYV or NV12 "
+        "from cameras that offer it) and detect on it; frames are turned "
+        "into color only for drawing }"
+        "{overlay  |true  | Draw markers, axes and the position of the first "
+        "marker on the shown frames }"
+        "{o        |<none>| Write per-frame results to this file, '-' for "
+        "stdout (default when headless) }"
+        "{fmt      |jsonl | Result format: jsonl or bin }"
+        "{j        |1     | Frames processed in parallel when reading a file, "
+        "0 for all cores }"
+        "{track    |false | Re-detect only around the markers of the previous "
+        "frame }"
+        "{rescan   |30    | With --track, scan the full frame every N frames }"
+        "{filter   |false | Smooth poses per marker id and predict markers "
+        "that are missed for up to half a second }"
+        "{every    |1     | Detect markers only on every Nth frame and predict "
+        "the poses in between, implies --filter }"
+        "{stats    |false | Print stage latency percentiles every --interval "
+        "seconds }"
+        "{prom     |<none>| Write stage latency histograms to this Prometheus "
+        "text file every --interval seconds }"
+        "{interval |5     | Seconds between stats reports }"
+        "{trace    |<none>| Write the first stage timings to this Chrome trace "
+        "file }"
+        "{rec      |<none>| Record the shown frames, the captured ones when "
+        "headless, to this video file }"
+        "{codec    |<none>| FourCC of the recording codec, e.g. MJPG, XVID or "
+        "mp4v; chosen from the file extension by default }"
+        "{recfps   |0     | Frame rate of the recording, 0 for that of the "
+        "source }"
+        "{recqueue |8     | Frames queued for the recording encoder }"
+        "{recpolicy|drop  | When the encoder falls behind: drop the oldest "
+        "queued frame, or block until it catches up }"
+        "{shm      |<none>| Publish the poses of every frame to this shared "
+        "memory ring, e.g. /aruco_poses, for pose_subscriber }"
+        "{udp      |<none>| Publish the poses of every frame as datagrams to "
+        "host:port }"
+        "{shmforce |false | Replace an existing shared memory ring of the "
+        "same name, e.g. one left behind by a crashed publisher }"
         ;
+
+std::vector<cv::String> splitList(const cv::String& list)
+{
+    std::vector<cv::String> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+// Result file of one camera: poses.bin -> poses_cam1.bin
+cv::String cameraPath(const cv::String& path, size_t camera)
+{
+    size_t slash = path.find_last_of("/\\");
+    size_t dot = path.find_last_of('.');
+    if (dot == cv::String::npos || (slash != cv::String::npos && dot < slash))
+        dot = path.size();
+    std::ostringstream name;
+    name << path.substr(0, dot) << "_cam" << camera << path.substr(dot);
+    return name.str();
+}
+
+struct CameraSettings
+{
+    float marker_length_m;
+    int workers;
+    bool headless;
+    bool show_overlay;
+    bool gray;
+    int tune_interval;
+    cv::Size resolution;
+    bool write_results;
+    cv::String results_format;
+    cv::String results_path;
+    double sync_tolerance;
+    aruco_markers::PoseOutput* pose_output;
+};
+
+/**
+ * Pose estimation of several cameras sharing one detector and one worker
+ * pool. Results of each camera go to their own file, the frames of each
+ * camera to their own window.
+ */
+int runCameras(const std::vector<cv::String>& sources,
+               const std::vector<cv::String>& calibrations,
+               const aruco_markers::MarkerDetector& detector,
+               const CameraSettings& settings)
+{
+    const size_t count = sources.size();
+    std::vector<cv::VideoCapture> captures(count);
+    std::vector<aruco_markers::SourceKind> kinds(count);
+    std::vector<cv::Ptr<aruco_markers::LumaCapture> > lumas(count);
+    // marker sizes differ between cameras, each is tuned on its own
+    std::vector<cv::Ptr<aruco_markers::DetectorAutoTuner> > tuners(count);
+    std::vector<cv::Mat> camera_matrices(count), dist_coeffs(count);
+    std::vector<cv::Ptr<aruco_markers::SquarePoseSolver> > solvers(count);
+    std::vector<cv::Ptr<aruco_markers::PoseOverlay> > overlays(count);
+    std::vector<cv::Ptr<aruco_markers::ResultWriter> > results(count);
+
+    for (size_t c = 0; c < count; c++) {
+        kinds[c] = aruco_markers::openSource(captures[c], sources[c]);
+        if (!captures[c].isOpened()) {
+            std::cerr << "failed to open video input: " << sources[c]
+                      << std::endl;
+            return 1;
+        }
+        aruco_markers::setResolution(captures[c], settings.resolution);
+        lumas[c] = cv::makePtr<aruco_markers::LumaCapture>(captures[c]);
+        if (settings.gray)
+            std::cerr << "camera " << c << ": capturing "
+                      << aruco_markers::LumaCapture::formatName(
+                             lumas[c]->configure())
+                      << " frames as gray" << std::endl;
+        cv::Size frame_size = aruco_markers::setResolution(captures[c],
+                                                           cv::Size());
+        if (!aruco_markers::loadIntrinsics(calibrations[c], frame_size,
+                                           camera_matrices[c],
+                                           dist_coeffs[c]))
+            return 1;
+        if (settings.tune_interval > 0) {
+            tuners[c] = cv::makePtr<aruco_markers::DetectorAutoTuner>(
+                detector, settings.tune_interval);
+        }
+        // frames of one camera are solved out of order, so no warm start
+        solvers[c] = cv::makePtr<aruco_markers::SquarePoseSolver>(
+            settings.marker_length_m, camera_matrices[c], dist_coeffs[c]);
+        overlays[c] = cv::makePtr<aruco_markers::PoseOverlay>(
+            aruco_markers::PoseOverlay::AXES, settings.marker_length_m,
+            camera_matrices[c], dist_coeffs[c]);
+        if (settings.write_results) {
+            cv::String path = cameraPath(settings.results_path, c);
+            results[c] = aruco_markers::ResultWriter::create(
+                settings.results_format, path);
+            if (!results[c]) {
+                std::cerr << "failed to open " << settings.results_format
+                          << " result output: " << path << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    aruco_markers::MultiCameraPipeline pipeline(settings.workers);
+    pipeline.setSyncTolerance(settings.sync_tolerance);
+    for (size_t c = 0; c < count; c++) {
+        cv::VideoCapture& capture = captures[c];
+        aruco_markers::LumaCapture& luma = *lumas[c];
+        bool gray = settings.gray;
+        // files are aligned on their own time lines, not on how fast they
+        // are read, so the sets do not depend on the machine
+        aruco_markers::MultiCameraPipeline::ClockStage clock;
+        if (kinds[c] == aruco_markers::FILE_SOURCE) {
+            double fps = capture.get(cv::CAP_PROP_FPS);
+            clock = [&capture, fps](int64_t index) {
+                return fps > 0 ? index / fps
+                               : capture.get(cv::CAP_PROP_POS_MSEC) / 1000.0;
+            };
+        }
+        pipeline.addCamera([&capture, &luma, gray](cv::Mat& image) {
+            if (!capture.grab())
+                return false;
+            return gray ? luma.retrieve(image) : capture.retrieve(image);
+        }, clock);
+    }
+
+    pipeline.setDetection([&](size_t camera, aruco_markers::Frame& frame) {
+        if (tuners[camera])
+            tuners[camera]->detect(detector, frame.image, frame.corners,
+                                   frame.ids);
+        else
+            detector.detect(frame.image, frame.corners, frame.ids);
+    });
+
+    pipeline.setPose([&](size_t camera, aruco_markers::Frame& frame) {
+        solvers[camera]->solve(frame.corners, frame.ids, frame.rvecs,
+                               frame.tvecs);
+    });
+
+    std::vector<cv::Mat> image_copies(count);
+    int64_t set_count = 0;
+    pipeline.setOutput([&](std::vector<aruco_markers::Frame>& frames) {
+        set_count++;
+        for (size_t c = 0; c < count; c++) {
+            aruco_markers::Frame& frame = frames[c];
+            if (results[c])
+                results[c]->write(frame);
+            // one message per camera, consumers tell them apart
+            settings.pose_output->publish(frame, static_cast<uint32_t>(c));
+            if (settings.headless)
+                continue;
+
+            cv::Mat shown = frame.image;
+            if (settings.show_overlay && frame.ids.size() > 0) {
+                aruco_markers::copyToCanvas(frame.image, image_copies[c]);
+                overlays[c]->draw(image_copies[c], frame.corners, frame.ids,
+                                  frame.rvecs, frame.tvecs);
+                shown = image_copies[c];
+            }
+            std::ostringstream window;
+            window << "Pose estimation " << c;
+            cv::imshow(window.str(), shown);
+        }
+        if (settings.headless)
+            return true;
+        char key = (char)cv::waitKey(1);
+        return key != 27;
+    });
+
+    int64_t start_ticks = cv::getTickCount();
+    pipeline.run();
+    double seconds = (cv::getTickCount() - start_ticks) /
+                     cv::getTickFrequency();
+
+    std::cerr << "processed " << set_count << " frames per camera in "
+              << seconds << " s (" << set_count / seconds << " fps)";
+    for (size_t c = 0; c < count; c++)
+        std::cerr << (c ? ", " : "; dropped to align: ") << "camera " << c
+                  << " " << pipeline.dropped(c);
+    std::cerr << std::endl;
+    for (size_t c = 0; c < count; c++)
+        if (tuners[c]) {
+            std::cerr << "camera " << c << " ";
+            tuners[c]->report(std::cerr);
+        }
+    for (size_t c = 0; c < count; c++) {
+        if (!results[c])
+            continue;
+        results[c]->flush();
+        if (results[c]->failed())
+            return 1;
+    }
+    return 0;
+}
 }
 
 int main(int argc, char **argv)
@@ -62,6 +331,23 @@ int main(int argc, char **argv)
     int dictionaryId = parser.get<int>("d");
     float marker_length_m = parser.get<float>("l");
     int wait_time = 10;
+    int decimation = parser.get<int>("dec");
+    bool undistort = parser.get<bool>("undistort");
+    int tiles = parser.get<int>("tiles");
+    int tile_overlap = parser.get<int>("overlap");
+    int workers = parser.get<int>("j");
+    bool headless = parser.get<bool>("headless");
+    bool show_overlay = parser.get<bool>("overlay");
+    bool gray = parser.get<bool>("gray");
+    cv::String results_path = parser.has("o") ? parser.get<cv::String>("o")
+                                              : cv::String("-");
+    cv::String results_format = parser.get<cv::String>("fmt");
+    bool track = parser.get<bool>("track");
+    int rescan_interval = parser.get<int>("rescan");
+    int detect_every = parser.get<int>("every");
+    bool filter_poses = parser.get<bool>("filter") || detect_every > 1;
+    bool print_stats = parser.get<bool>("stats");
+    double stats_interval = parser.get<double>("interval");
 
     if (marker_length_m <= 0) {
         std::cerr << "marker length must be a positive value in meter" 
@@ -69,22 +355,132 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    if (decimation < 1) {
+        std::cerr << "decimation factor must be at least 1" << std::endl;
+        return 1;
+    }
+
+    if (tiles < 1 || tile_overlap < 0) {
+        std::cerr << "tiles must be at least 1 and the overlap must not be "
+                     "negative" << std::endl;
+        return 1;
+    }
+
+    if (workers < 0) {
+        std::cerr << "number of parallel frames must not be negative"
+                  << std::endl;
+        return 1;
+    }
+
+    if (detect_every < 1) {
+        std::cerr << "detection interval must be at least 1" << std::endl;
+        return 1;
+    }
+
+    if (stats_interval <= 0) {
+        std::cerr << "stats interval must be positive" << std::endl;
+        return 1;
+    }
+
+    aruco_markers::RecorderOptions record_options;
+    if (!aruco_markers::readRecorderOptions(parser, record_options))
+        return 1;
+
+    int tune_interval = 0;
+    cv::Ptr<cv::aruco::DetectorParameters> detector_params;
+    if (!aruco_markers::readDetectorOptions(parser, detector_params,
+                                            tune_interval))
+        return 1;
+
+    if (track && tune_interval > 0) {
+        std::cerr << "--track already limits detection to the tracked "
+                     "markers and cannot be combined with --tune"
+                  << std::endl;
+        return 1;
+    }
+
+
+    cv::Size resolution;
+    if (parser.has("res") &&
+        !aruco_markers::parseResolution(parser.get<cv::String>("res"),
+                                        resolution)) {
+        std::cerr << "resolution must be given as <width>x<height>"
+                  << std::endl;
+        return 1;
+    }
+
+    // local consumers read the poses without going through a socket
+    aruco_markers::PoseOutput pose_output;
+    if (!aruco_markers::openPoseOutput(parser, pose_output))
+        return 1;
+
+    std::vector<cv::String> sources;
+    if (parser.has("v"))
+        sources = splitList(parser.get<cv::String>("v"));
+    if (sources.size() > 1) {
+        std::vector<cv::String> calibrations =
+            splitList(parser.get<cv::String>("calib"));
+        if (calibrations.size() != sources.size()) {
+            std::cerr << "give one calibration file per source with --calib"
+                      << std::endl;
+            return 1;
+        }
+        if (track || filter_poses || undistort || print_stats ||
+            parser.has("prom") || parser.has("trace") || parser.has("rec")) {
+            std::cerr << "--track, --filter, --every, --undistort, --stats, "
+                         "--prom, --trace and --rec need a single source"
+                      << std::endl;
+            return 1;
+        }
+        if (parser.has("o") && aruco_markers::isStdoutPath(results_path)) {
+            std::cerr << "several sources write one result file each, give "
+                         "a file name with -o" << std::endl;
+            return 1;
+        }
+        if (headless && !parser.has("o") && !pose_output.isOpened()) {
+            std::cerr << "several sources need a result file name with -o, "
+                         "--shm or --udp when headless" << std::endl;
+            return 1;
+        }
+        if (!parser.check()) {
+            parser.printErrors();
+            return 1;
+        }
+
+        cv::Ptr<cv::aruco::Dictionary> dictionary =
+            cv::aruco::getPredefinedDictionary(
+            cv::aruco::PREDEFINED_DICTIONARY_NAME(dictionaryId));
+        aruco_markers::MarkerDetector detector(dictionary, detector_params);
+        detector.setDecimation(decimation);
+        detector.setTiling(tiles, tile_overlap);
+
+        CameraSettings settings;
+        settings.marker_length_m = marker_length_m;
+        // the pool is shared by all cameras, use every core unless told
+        settings.workers = parser.has("j") ? workers : 0;
+        settings.headless = headless;
+        settings.show_overlay = show_overlay;
+        settings.gray = gray;
+        settings.tune_interval = tune_interval;
+        settings.resolution = resolution;
+        settings.write_results = parser.has("o");
+        settings.results_format = results_format;
+        settings.results_path = results_path;
+        settings.sync_tolerance = parser.get<double>("sync") / 1000.0;
+        settings.pose_output = &pose_output;
+        return runCameras(sources, calibrations, detector, settings);
+    }
+
     cv::String videoInput = "0";
     cv::VideoCapture in_video;
+    aruco_markers::SourceKind source_kind = aruco_markers::CAMERA_SOURCE;
     if (parser.has("v")) {
         videoInput = parser.get<cv::String>("v");
         if (videoInput.empty()) {
             parser.printMessage();
             return 1;
         }
-        char* end = nullptr;
-        int source = static_cast<int>(std::strtol(videoInput.c_str(), &end, \
-            10));
-        if (!end || end == videoInput.c_str()) {
-            in_video.open(videoInput); // url
-        } else {
-            in_video.open(source); // id
-        }
+        source_kind = aruco_markers::openSource(in_video, videoInput);
     } else {
         in_video.open(0);
     }
@@ -98,80 +494,268 @@ int main(int argc, char **argv)
         std::cerr << "failed to open video input: " << videoInput << std::endl;
         return 1;
     }
+    aruco_markers::setResolution(in_video, resolution);
+
+    cv::Ptr<aruco_markers::ResultWriter> results;
+    if (headless || parser.has("o")) {
+        results = aruco_markers::ResultWriter::create(results_format,
+                                                      results_path);
+        if (!results) {
+            std::cerr << "failed to open " << results_format
+                      << " result output: " << results_path << std::endl;
+            return 1;
+        }
+    }
 
-    cv::Mat image, image_copy;
     cv::Mat camera_matrix, dist_coeffs;
-    std::ostringstream vector_to_marker;
 
     cv::Ptr<cv::aruco::Dictionary> dictionary =
         cv::aruco::getPredefinedDictionary( \
         cv::aruco::PREDEFINED_DICTIONARY_NAME(dictionaryId));
+    aruco_markers::MarkerDetector detector(dictionary, detector_params);
+    detector.setDecimation(decimation);
+    detector.setTiling(tiles, tile_overlap);
+    cv::Ptr<aruco_markers::DetectorAutoTuner> tuner;
+    if (tune_interval > 0)
+        tuner = cv::makePtr<aruco_markers::DetectorAutoTuner>(detector,
+                                                              tune_interval);
+
+    // keep stdout clean when it carries the per-frame results
+    std::ostream& info = results && aruco_markers::isStdoutPath(results_path)
+                       ? std::cerr : std::cout;
+
+    // detection needs one channel, skip the BGR decode where possible
+    aruco_markers::LumaCapture luma(in_video);
+    if (gray)
+        info << "capturing "
+             << aruco_markers::LumaCapture::formatName(luma.configure())
+             << " frames as gray" << std::endl;
 
-    cv::FileStorage fs("calibration_params.yml", cv::FileStorage::READ);
+    // the calibration profile for the resolution frames arrive in, which
+    // the capture format chosen above may have changed
+    cv::Size frame_size = aruco_markers::setResolution(in_video, cv::Size());
+    const std::string calibration_path = parser.get<cv::String>("calib");
+    if (!aruco_markers::loadIntrinsics(calibration_path, frame_size,
+                                       camera_matrix, dist_coeffs))
+        return 1;
+    info << "camera_matrix\n" << camera_matrix << std::endl;
+    info << "\ndist coeffs\n" << dist_coeffs << std::endl;
+
+    // Rectify corners through the cached lookup table; pose and overlays
+    // then work on an ideal pinhole camera without distortion.
+    aruco_markers::UndistortionCache undistortion;
+    if (undistort) {
+        if (!undistortion.load(calibration_path, camera_matrix, dist_coeffs,
+                               frame_size)) {
+            std::cerr << "failed to prepare undistortion for " << frame_size
+                      << std::endl;
+            return 1;
+        }
+        camera_matrix = undistortion.cameraMatrix();
+        dist_coeffs = cv::Mat();
+    }
 
-    fs["camera_matrix"] >> camera_matrix;
-    fs["distortion_coefficients"] >> dist_coeffs;
+    aruco_markers::Stats stats;
+    const int grab_stage = stats.addStage("grab");
+    const int retrieve_stage = stats.addStage("retrieve");
+    const int detect_stage = stats.addStage("detect");
+    const int pose_stage = stats.addStage("pose");
+    const int latency_stage = stats.addStage("capture_to_pose");
+    const int copy_stage = stats.addStage("copy");
+    const int draw_stage = stats.addStage("draw");
+    const int show_stage = stats.addStage("show");
 
-    std::cout << "camera_matrix\n" << camera_matrix << std::endl;
-    std::cout << "\ndist coeffs\n" << dist_coeffs << std::endl;
+    if (print_stats || parser.has("prom")) {
+        stats.enable();
+        stats.startReporting(stats_interval, print_stats ? &info : nullptr,
+                             parser.has("prom") ? parser.get<cv::String>("prom")
+                                                : cv::String());
+    }
+    if (parser.has("trace") &&
+        !stats.enableTrace(parser.get<cv::String>("trace"))) {
+        std::cerr << "failed to open trace output: "
+                  << parser.get<cv::String>("trace") << std::endl;
+        return 1;
+    }
 
-    while (in_video.grab())
-    {
-        in_video.retrieve(image);
-        image.copyTo(image_copy);
-        std::vector<int> ids;
-        std::vector<std::vector<cv::Point2f> > corners;
-        cv::aruco::detectMarkers(image, dictionary, corners, ids);
+    aruco_markers::Pipeline pipeline;
 
-        // if at least one marker detected
-        if (ids.size() > 0)
+    aruco_markers::VideoRecorder recorder(record_options.queue_capacity,
+                                          record_options.policy);
+    if (!aruco_markers::openRecorder(record_options,
+                                     in_video.get(cv::CAP_PROP_FPS),
+                                     frame_size, recorder))
+        return 1;
+
+    // frames of a file are independent, a camera is processed in order;
+    // ROI tracking and pose filtering depend on the previous frame and
+    // stay sequential
+    bool in_order = true;
+    if (source_kind != aruco_markers::CAMERA_SOURCE && workers != 1) {
+        if (track || filter_poses) {
+            std::cerr << "--track and --filter process frames sequentially, "
+                         "ignoring -j" << std::endl;
+        } else {
+            pipeline.setWorkers(workers);
+            in_order = false;
+        }
+    }
+
+    // warm start needs the previous frame's poses
+    aruco_markers::SquarePoseSolver pose_solver(marker_length_m,
+                                                camera_matrix, dist_coeffs);
+    pose_solver.setWarmStart(in_order);
+    aruco_markers::PoseOverlay overlay(aruco_markers::PoseOverlay::AXES,
+                                       marker_length_m, camera_matrix,
+                                       dist_coeffs);
+
+    // a recording is filtered on its own time line, however fast it is
+    // read; a stream drops frames like a camera, so it uses the clock
+    aruco_markers::PoseFilter pose_filter;
+    double file_fps = source_kind == aruco_markers::FILE_SOURCE
+                          ? in_video.get(cv::CAP_PROP_FPS) : 0.0;
+
+    bool size_mismatch = false;
+    pipeline.setCapture([&](cv::Mat& image) {
+        aruco_markers::StageTimer grab_timer(stats, grab_stage);
+        if (!in_video.grab())
+            return false;
+        grab_timer.stop();
+        aruco_markers::StageTimer retrieve_timer(stats, retrieve_stage);
+        if (!(gray ? luma.retrieve(image) : in_video.retrieve(image)))
+            return false;
+        // the tables were built for the size the capture reported
+        if (undistort &&
+            !aruco_markers::checkFrameSize(image, undistortion.size())) {
+            size_mismatch = true;
+            return false;
+        }
+        return true;
+    });
+
+    aruco_markers::DetectFunction detect = [&](const cv::Mat& image,
+            aruco_markers::MarkerCorners& corners, std::vector<int>& ids) {
+        detector.detect(image, corners, ids);
+    };
+    aruco_markers::RoiTracker tracker(detect, rescan_interval);
+
+    pipeline.setDetection([&](aruco_markers::Frame& frame) {
+        if (frame.index % detect_every != 0)
+            return;
+        aruco_markers::StageTimer timer(stats, detect_stage);
+        if (track) {
+            tracker.detect(frame.image, frame.corners, frame.ids);
+        } else if (tuner) {
+            tuner->detect(detector, frame.image, frame.corners, frame.ids);
+        } else {
+            detect(frame.image, frame.corners, frame.ids);
+        }
+    });
+
+    pipeline.setPose([&](aruco_markers::Frame& frame) {
+        aruco_markers::StageTimer timer(stats, pose_stage);
+        if (undistort && frame.ids.size() > 0)
+            undistortion.rectify(frame.corners, frame.corners);
+        // frames skipped by --every keep the warm start of the last detection
+        if (!frame.corners.empty())
+            pose_solver.solve(frame.corners, frame.ids, frame.rvecs,
+                              frame.tvecs);
+        if (filter_poses) {
+            double time = file_fps > 0 ? frame.index / file_fps
+                                       : frame.timestamp;
+            pose_filter.filter(time, frame.ids, frame.rvecs, frame.tvecs,
+                               &frame.predicted);
+            // predicted markers get the corners of their predicted pose
+            for (size_t i = frame.corners.size(); i < frame.ids.size(); i++)
+                frame.corners.push_back(aruco_markers::projectMarkerCorners(
+                    marker_length_m, camera_matrix, dist_coeffs,
+                    frame.rvecs[i], frame.tvecs[i]));
+        }
+        timer.stop();
+        if (stats.enabled())
+            stats.record(latency_stage, pipeline.elapsed() - frame.timestamp);
+    });
+
+    // reused overlay buffer, headless runs never touch it
+    cv::Mat image_copy;
+    int64_t frame_count = 0;
+    pipeline.setOutput([&](aruco_markers::Frame& frame) {
+        frame_count++;
+        if (results)
+            results->write(frame);
+        // publish before drawing, consumers should not wait for the display
+        pose_output.publish(frame);
+        if (headless) {
+            if (recorder.isOpened())
+                recorder.write(frame.image);
+            return true;
+        }
+
+        const std::vector<int>& ids = frame.ids;
+        bool draw = show_overlay && ids.size() > 0;
+
+        // if at least one marker detected, draw on a copy of the frame
+        cv::Mat shown = frame.image;
+        if (undistort || draw)
         {
-            cv::aruco::drawDetectedMarkers(image_copy, corners, ids);
-            std::vector<cv::Vec3d> rvecs, tvecs;
-            cv::aruco::estimatePoseSingleMarkers(corners, marker_length_m,
-                    camera_matrix, dist_coeffs, rvecs, tvecs);
-            
-            // Draw axis for each marker
-            for(int i=0; i < ids.size(); i++)
+            // frames shown as captured are not counted as copies
+            aruco_markers::StageTimer copy_timer(stats, copy_stage);
+            if (undistort)
             {
-                cv::aruco::drawAxis(image_copy, camera_matrix, dist_coeffs,
-                        rvecs[i], tvecs[i], 0.1);
-
-                // This section is going to print the data for all the detected
-                // markers. If you have more than a single marker, it is
-                // recommended to change the below section so that either you
-                // only print the data for a specific marker, or you print the
-                // data for each marker separately.
-                vector_to_marker.str(std::string());
-                vector_to_marker << std::setprecision(4)
-                                 << "x: " << std::setw(8) << tvecs[0](0);
-                cv::putText(image_copy, vector_to_marker.str(),
-                            cv::Point(10, 30), cv::FONT_HERSHEY_SIMPLEX, 0.6,
-                            cv::Scalar(0, 252, 124), 1, cv::LINE_AA);
-
-                vector_to_marker.str(std::string());
-                vector_to_marker << std::setprecision(4)
-                                 << "y: " << std::setw(8) << tvecs[0](1);
-                cv::putText(image_copy, vector_to_marker.str(),
-                            cv::Point(10, 50), cv::FONT_HERSHEY_SIMPLEX, 0.6,
-                            cv::Scalar(0, 252, 124), 1, cv::LINE_AA);
-
-                vector_to_marker.str(std::string());
-                vector_to_marker << std::setprecision(4)
-                                 << "z: " << std::setw(8) << tvecs[0](2);
-                cv::putText(image_copy, vector_to_marker.str(),
-                            cv::Point(10, 70), cv::FONT_HERSHEY_SIMPLEX, 0.6,
-                            cv::Scalar(0, 252, 124), 1, cv::LINE_AA);
+                undistortion.undistortImage(frame.image, image_copy);
+                shown = image_copy;
             }
+            if (draw)
+                aruco_markers::copyToCanvas(
+                    undistort ? image_copy : frame.image, image_copy);
+        }
+
+        aruco_markers::StageTimer draw_timer(stats, draw_stage);
+        if (draw)
+        {
+            shown = image_copy;
+            overlay.draw(image_copy, frame.corners, ids, frame.rvecs,
+                         frame.tvecs);
         }
 
-        imshow("Pose estimation", image_copy);
+        draw_timer.stop();
+
+        if (recorder.isOpened())
+            recorder.write(shown);
+
+        aruco_markers::StageTimer show_timer(stats, show_stage);
+        imshow("Pose estimation", shown);
         char key = (char)cv::waitKey(wait_time);
-        if (key == 27)
-            break;
+        return key != 27;
+    });
+
+    int64_t start_ticks = cv::getTickCount();
+    pipeline.run();
+    stats.stopReporting();
+
+    if (recorder.isOpened()) {
+        recorder.close();
+        info << "recorded " << recorder.written() << " frames, dropped "
+             << recorder.dropped() << std::endl;
+    }
+
+    if (headless) {
+        double seconds = (cv::getTickCount() - start_ticks) /
+                         cv::getTickFrequency();
+        std::cerr << "processed " << frame_count << " frames in " << seconds
+                  << " s (" << frame_count / seconds << " fps)" << std::endl;
     }
 
+    if (tuner)
+        tuner->report(info);
+
     in_video.release();
 
-    return 0;
+    // a failed write is reported by the writer, fail the run as well
+    if (results) {
+        results->flush();
+        if (results->failed())
+            return 1;
+    }
+    return size_mismatch ? 1 : 0;
 }
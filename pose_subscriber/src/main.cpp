@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "aruco_markers/pose_channel.hpp"
+#include "aruco_markers/pose_datagram.hpp"
+
+
+namespace {
+const char* about =
+        "Receive the poses published by pose_estimation or draw_cube\n"
+        "  Follows a shared memory ring (--shm) or listens for datagrams\n"
+        "  (--udp) and prints every frame as one JSON object per line; from\n"
+        "  shared memory including the time from publishing to receiving in\n"
+        "  microseconds.\n";
+const char* keys  =
+        "{shm      |<none>| Shared memory name given to the publisher, e.g. "
+        "/aruco_poses }"
+        "{udp      |<none>| host:port to listen on, e.g. 127.0.0.1:5005 }"
+        "{n        |0     | Stop after this many messages, 0 for no limit }"
+        "{timeout  |0     | Stop after this many seconds without a message, "
+        "0 waits forever }"
+        "{quiet    |false | Print only the summary, not the messages }"
+        "{h        |false | Print help }"
+        ;
+
+// latency_us is negative when unknown and then left out
+void printMessage(const aruco_markers::PoseMessage& message,
+                  double latency_us)
+{
+    std::printf("{\"frame\":%lld,\"t\":%.6f,\"camera\":%u,",
+                static_cast<long long>(message.frame), message.timestamp,
+                message.camera);
+    if (latency_us >= 0)
+        std::printf("\"latency_us\":%.1f,", latency_us);
+    std::printf("\"markers\":[");
+    for (uint32_t i = 0; i < message.count; i++) {
+        const aruco_markers::PoseRecord& r = message.markers[i];
+        std::printf("%s{\"id\":%d,%s\"rvec\":[%.6f,%.6f,%.6f],"
+                    "\"tvec\":[%.6f,%.6f,%.6f]}",
+                    i ? "," : "", r.id,
+                    r.flags & aruco_markers::kMarkerPredicted
+                        ? "\"predicted\":true," : "",
+                    r.rvec[0], r.rvec[1], r.rvec[2],
+                    r.tvec[0], r.tvec[1], r.tvec[2]);
+    }
+    std::printf("]}\n");
+}
+}
+
+int main(int argc, char **argv)
+{
+    cv::CommandLineParser parser(argc, argv, keys);
+    parser.about(about);
+
+    if (parser.get<bool>("h") || parser.has("shm") == parser.has("udp")) {
+        parser.printMessage();
+        return parser.get<bool>("h") ? 0 : 1;
+    }
+
+    int limit = parser.get<int>("n");
+    double timeout = parser.get<double>("timeout");
+    bool quiet = parser.get<bool>("quiet");
+
+    if (!parser.check()) {
+        parser.printErrors();
+        return 1;
+    }
+
+    aruco_markers::PoseSubscriber ring;
+    aruco_markers::PoseDatagramSubscriber datagrams;
+    if (parser.has("shm")) {
+        cv::String name = parser.get<cv::String>("shm");
+        // the publisher may start after us, a timeout bounds the wait
+        double waited = 0;
+        while (!ring.open(name)) {
+            if (timeout > 0 && waited >= timeout) {
+                std::cerr << "no publisher on shared memory " << name
+                          << std::endl;
+                return 1;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            waited += 0.1;
+        }
+    } else if (!datagrams.open(parser.get<cv::String>("udp"))) {
+        std::cerr << "failed to listen on " << parser.get<cv::String>("udp")
+                  << std::endl;
+        return 1;
+    }
+
+    // forever, in slices, when no timeout is given
+    double wait_time = timeout > 0 ? timeout : 1.0;
+    std::vector<double> latencies;
+    aruco_markers::PoseMessage message;
+    int received_count = 0;
+    while (limit <= 0 || received_count < limit) {
+        bool received = ring.isOpened() ? ring.wait(message, wait_time)
+                                        : datagrams.wait(message, wait_time);
+        if (!received) {
+            if (timeout > 0)
+                break;
+            continue;
+        }
+        received_count++;
+        // publish_ns comes from the publisher's monotonic clock, which only
+        // means something on the same host, so datagrams carry no latency
+        double latency_us = -1;
+        if (ring.isOpened()) {
+            int64_t delta = static_cast<int64_t>(
+                    aruco_markers::monotonicNanoseconds() - message.publish_ns);
+            latency_us = std::max<int64_t>(delta, 0) / 1000.0;
+            latencies.push_back(latency_us);
+        }
+        if (!quiet) {
+            printMessage(message, latency_us);
+            std::fflush(stdout);
+        }
+    }
+
+    std::cerr << "received " << received_count << " messages, lost "
+              << (ring.isOpened() ? ring.lost() : datagrams.lost());
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        std::cerr << ", latency p50 " << latencies[latencies.size() / 2]
+                  << " us, p99 "
+                  << latencies[std::min(latencies.size() - 1,
+                                        latencies.size() * 99 / 100)]
+                  << " us";
+    }
+    std::cerr << std::endl;
+    return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2019 Flight Dynamics and Control Lab
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <opencv2/core.hpp>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "aruco_markers/pose_log.hpp"
+#include "aruco_markers/result_writer.hpp"
+
+
+namespace {
+const char* about =
+        "Query a binary result log without re-running detection\n"
+        "  Reads a log written with --fmt=bin by detect_markers or\n"
+        "  pose_estimation. Frames are selected by frame index or by time\n"
+        "  and written as JSON lines or as a new binary log; with --id the\n"
+        "  trajectory of one marker is written as CSV instead.\n";
+const char* keys  =
+        "{@log     |<none>| Binary result log }"
+        "{from     |-1    | First frame index }"
+        "{to       |-1    | Last frame index }"
+        "{t0       |-1    | Start time in seconds, instead of --from }"
+        "{t1       |-1    | End time in seconds, instead of --to }"
+        "{id       |-1    | Write the pose of this marker id per frame as CSV "
+        "(frame,t,rx,ry,rz,tx,ty,tz) }"
+        "{info     |false | Print the number of frames, their time span and "
+        "the marker ids }"
+        "{o        |<none>| Output file, otherwise stdout }"
+        "{fmt      |jsonl | Frame output format: jsonl or bin }"
+        "{h        |false | Print help }"
+        ;
+}
+
+int main(int argc, char **argv)
+{
+    cv::CommandLineParser parser(argc, argv, keys);
+    parser.about(about);
+
+    if (argc < 2 || parser.get<bool>("h")) {
+        parser.printMessage();
+        return argc < 2 ? 1 : 0;
+    }
+
+    cv::String log_path = parser.get<cv::String>(0);
+    int from_frame = parser.get<int>("from");
+    int to_frame = parser.get<int>("to");
+    double from_time = parser.get<double>("t0");
+    double to_time = parser.get<double>("t1");
+    int marker_id = parser.get<int>("id");
+    bool info = parser.get<bool>("info");
+    cv::String output_path = parser.has("o") ? parser.get<cv::String>("o")
+                                             : cv::String("-");
+    cv::String output_format = parser.get<cv::String>("fmt");
+
+    if (!parser.check()) {
+        parser.printErrors();
+        return 1;
+    }
+
+    aruco_markers::PoseLogReader log;
+    if (!log.open(log_path)) {
+        std::cerr << "failed to open binary result log: " << log_path
+                  << std::endl;
+        return 1;
+    }
+
+    if (info) {
+        std::cout << log.size() << " frames";
+        if (log.size() > 0) {
+            const aruco_markers::PoseLogEntry& first = log.entry(0);
+            const aruco_markers::PoseLogEntry& last = log.entry(log.size() - 1);
+            std::cout << ", frame " << first.frame << " to " << last.frame
+                      << ", " << first.timestamp << " s to "
+                      << last.timestamp << " s";
+        }
+        std::cout << (log.indexed() ? "" : ", no index") << std::endl;
+        std::vector<int> ids = log.ids();
+        std::cout << "ids:";
+        for (size_t i = 0; i < ids.size(); i++)
+            std::cout << " " << ids[i];
+        std::cout << std::endl;
+        return 0;
+    }
+
+    // both ends are looked up in the index, the records between are
+    // the only ones read
+    size_t begin = 0, end = log.size();
+    if (from_time >= 0)
+        begin = log.seekTime(from_time);
+    else if (from_frame >= 0)
+        begin = log.seekFrame(from_frame);
+    if (to_time >= 0)
+        end = log.seekTime(to_time);
+    else if (to_frame >= 0)
+        end = log.seekFrame(static_cast<int64_t>(to_frame) + 1);
+    // an end time matching a frame exactly includes it
+    while (to_time >= 0 && end < log.size() &&
+           log.entry(end).timestamp == to_time)
+        end++;
+
+    if (marker_id >= 0) {
+        std::FILE* out = stdout;
+        if (!aruco_markers::isStdoutPath(output_path)) {
+            out = std::fopen(output_path.c_str(), "w");
+            if (!out) {
+                std::cerr << "failed to open output file: " << output_path
+                          << std::endl;
+                return 1;
+            }
+        }
+        std::fputs("frame,t,rx,ry,rz,tx,ty,tz\n", out);
+        cv::Vec3d rvec, tvec;
+        for (size_t r = begin; r < end; r++) {
+            if (!log.findPose(r, marker_id, rvec, tvec))
+                continue;
+            std::fprintf(out, "%lld,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n",
+                         static_cast<long long>(log.entry(r).frame),
+                         log.entry(r).timestamp, rvec[0], rvec[1], rvec[2],
+                         tvec[0], tvec[1], tvec[2]);
+        }
+        if (out != stdout)
+            std::fclose(out);
+        return 0;
+    }
+
+    cv::Ptr<aruco_markers::ResultWriter> results =
+        aruco_markers::ResultWriter::create(output_format, output_path);
+    if (!results) {
+        std::cerr << "failed to open " << output_format
+                  << " result output: " << output_path << std::endl;
+        return 1;
+    }
+    aruco_markers::Frame frame;
+    for (size_t r = begin; r < end; r++) {
+        log.read(r, frame);
+        results->write(frame);
+    }
+
+    results->flush();
+    if (results->failed())
+        return 1;
+    return 0;
+}